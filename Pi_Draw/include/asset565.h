@@ -0,0 +1,80 @@
+#pragma once
+
+#include "display_types.h"
+#include "mapped_file.h"
+#include "tools.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// формат .565: заранее пересчитанные пиксели в порядке байт панели.
+//
+// заголовок, 16 байт, поля little-endian:
+//   0  "R565"
+//   4  версия (1)
+//   5  флаги: ASSET565_BIG_ENDIAN - пиксели старшим байтом вперёд, ASSET565_RLE
+//   6  ширина, 8 высота
+//   10 ширина и 12 высота плитки, 0 - одна плитка на всё изображение
+//   14 резерв
+// далее плитки построчно, крайние обрезаны по изображению, внутри плитки
+// строки подряд. со сжатием после заголовка идёт таблица смещений плиток
+// (uint32, count + 1 значений от начала данных), данные плитки - пакеты
+// с заголовком uint16: старший бит - повтор следующего пикселя, иначе
+// столько пикселей подряд; число пикселей - младшие 15 бит плюс один
+constexpr uint8_t ASSET565_BIG_ENDIAN = 0x01;
+constexpr uint8_t ASSET565_RLE = 0x02;
+
+struct Asset565Options {
+    uint16_t tile_width = 0;
+    uint16_t tile_height = 0;
+    bool rle = false;
+    // панель принимает RGB565 старшим байтом вперёд
+    bool big_endian = true;
+};
+
+// .565, отображённый в память. несжатые плитки в порядке байт панели
+// можно отдавать в SPI прямо из отображённых страниц
+class Asset565 {
+public:
+    struct Tile {
+        Rectangle rect;
+        // данные плитки в файле: пиксели или пакеты RLE
+        const uint8_t* data = nullptr;
+        size_t length = 0;
+    };
+
+    bool open(const std::string& filename);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    uint16_t getWidth() const { return width; }
+    uint16_t getHeight() const { return height; }
+    bool isBigEndian() const { return flags & ASSET565_BIG_ENDIAN; }
+    bool isRLE() const { return flags & ASSET565_RLE; }
+
+    size_t getTileCount() const { return static_cast<size_t>(tiles_x) * tiles_y; }
+    Tile getTile(size_t index) const;
+    // пиксели плитки в порядке байт процессора, rect.width * rect.height значений
+    bool decodeTile(size_t index, uint16_t* pixels) const;
+
+private:
+    std::unique_ptr<MappedFile> file;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    uint8_t flags = 0;
+    uint16_t tile_width = 0;
+    uint16_t tile_height = 0;
+    uint16_t tiles_x = 0;
+    uint16_t tiles_y = 0;
+    const uint8_t* pixel_data = nullptr;
+    size_t pixel_size = 0;
+    // таблица смещений плиток, только для RLE
+    const uint8_t* offsets = nullptr;
+
+    Rectangle tileRect(size_t index) const;
+};
+
+bool saveAsset565(const std::string& filename, const ImageData& image, const Asset565Options& options);
+// полная распаковка в ImageData, для кэша и превью
+bool loadAsset565(const std::string& filename, ImageData& image);
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "dither.h"
+#include "tools.h"
+#include <string>
+
+// загрузка BMP без промежуточных буферов: файл отображается в память,
+// строки пересчитываются в RGB565 прямо в image.pixels за один проход.
+// поддерживаются 24 и 32 бита (BI_RGB, BI_BITFIELDS с маской BGRX) и
+// 8 бит с палитрой, строки снизу вверх и сверху вниз. при сглаживании
+// строки всё равно идут сверху вниз, как требует диффузия ошибки
+bool loadBMP(const std::string& filename, ImageData& image, DitherMode dither = DitherMode::None);
@@ -3,6 +3,7 @@
 
 #include "tools.h"
 #include "display_pi.h"
+#include "flood_fill.h"
 #include <SFML/Graphics.hpp>
 #include <vector>
 
@@ -11,18 +12,56 @@ public:
     Canvas(const sf::Vector2f& position, const sf::Vector2f& size, TFTDisplay& display);
     void draw(sf::RenderWindow& window);
     void handleEvent(const sf::Event& event, DrawingProperties& props);
+    // call once per frame after all events: pencil and eraser motion is
+    // collected into one polyline and sent to the panel in a single flush
+    void commitInput(const DrawingProperties& props);
     void clear();
+    // fit the whole panel into the canvas area at the largest integer zoom
+    void resetView();
 
 private:
+    static constexpr int MAX_ZOOM = 16;
+
     sf::RectangleShape canvas;
     TFTDisplay& tftDisplay;
     sf::Vector2f canvasPosition;
     sf::Vector2f canvasSize;
+    std::vector<Span> spans;
+    FloodFill floodFill;
+
+    // pencil/eraser points not yet on the panel; the first one is the end
+    // of the already drawn part, so batches join up without gaps
+    std::vector<Point> strokePoints;
+    bool strokePending;
+    TraceEventRange strokeEvents;
+
+    // preview of the panel: texture is kept in sync with the pixels sent by
+    // present(), only the regions that changed are uploaded each frame
+    sf::Texture preview;
+    sf::Sprite previewSprite;
+    std::vector<sf::Uint8> uploadBuffer;
+    std::vector<Rectangle> updatedRects;
+
+    // panel pixel (x, y) is shown at canvasPosition + pan + (x, y) * zoom
+    int zoom;
+    sf::Vector2f pan;
+    bool panning;
+    sf::Vector2f panAnchor;
+
+    void updatePreview();
+    void uploadRect(const Rectangle& rect);
+    void zoomAt(const sf::Vector2f& windowPos, int newZoom);
 
+    static bool isFreehand(Tool tool);
+    static bool isFill(Tool tool);
+    void addStrokePoint(const Point& point);
+    void commitStroke(const DrawingProperties& props);
     void drawToDisplay(const DrawingProperties& props);
-    void drawLine(const Point& start, const Point& end, uint16_t color, uint8_t width);
+    void fillAt(const Point& point, DrawingProperties& props);
+    void drawLine(const Point& start, const Point& end, uint16_t color, uint8_t width, LineCap cap);
     void drawRectangle(const Point& start, const Point& end, uint16_t color, uint8_t width, bool filled);
     void drawCircle(const Point& center, uint16_t radius, uint16_t color, uint8_t width, bool filled);
+    void drawEllipse(const Point& start, const Point& end, uint16_t color, uint8_t width, bool filled);
     Point windowToCanvas(const sf::Vector2f& windowPos) const;
     bool isInsideCanvas(const sf::Vector2f& point) const;
 };
@@ -13,6 +13,7 @@ constexpr uint8_t CMD_PTLON       = 0x12;
 constexpr uint8_t CMD_NORON       = 0x13;
 constexpr uint8_t CMD_INVOFF      = 0x20;
 constexpr uint8_t CMD_INVON       = 0x21;
+constexpr uint8_t CMD_GAMSET      = 0x26;
 constexpr uint8_t CMD_DISPOFF     = 0x28;
 constexpr uint8_t CMD_DISPON      = 0x29;
 constexpr uint8_t CMD_CASET       = 0x2A;
@@ -20,8 +21,12 @@ constexpr uint8_t CMD_RASET       = 0x2B;
 constexpr uint8_t CMD_RAMWR       = 0x2C;
 constexpr uint8_t CMD_RAMRD       = 0x2E;
 constexpr uint8_t CMD_PTLAR       = 0x30;
+constexpr uint8_t CMD_VSCRDEF     = 0x33;
+constexpr uint8_t CMD_VSCSAD      = 0x37;
 constexpr uint8_t CMD_COLMOD      = 0x3A;
 constexpr uint8_t CMD_MADCTL      = 0x36;
+constexpr uint8_t CMD_IDMOFF      = 0x38;
+constexpr uint8_t CMD_IDMON       = 0x39;
 constexpr uint8_t CMD_FRMCTR1     = 0xB1;
 constexpr uint8_t CMD_FRMCTR2     = 0xB2;
 constexpr uint8_t CMD_FRMCTR3     = 0xB3;
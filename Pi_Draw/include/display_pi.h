@@ -3,29 +3,118 @@
 #include "colors.h"
 #include "commands.h"
 #include "display_types.h"
+#include "flush_planner.h"
+#include "fonts.h"
+#include "pixel_format.h"
+#include "raster.h"
 #include "spi_pi.h"
+#include "trace.h"
+#include <condition_variable>
 #include <cstdint>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+class Asset565;
+
+// режим отправки кадров на панель
+enum class FlushMode {
+    Sync,  // present() сам пишет в SPI
+    Async  // present() передаёт кадр потоку отправки
+};
+
 class TFTDisplay {
 private:
     SPIDevice spi;
-    int reset_pin;
-    int dc_pin;
     int width;
     int height;
+    int panel_width;
+    int panel_height;
     DisplayRotation rotation;
     uint16_t current_color;
     Font current_font;
+    GlyphCache glyph_cache;
+
+    // кадровый буфер: все примитивы рисуют сюда, на панель уходит только present()
+    static constexpr size_t MAX_DIRTY_RECTS = 8;
+    static constexpr int SPI_SPEED = 8000000;
+    std::vector<uint16_t> framebuffer;
+    std::vector<Rectangle> dirty_rects;
+    // области, выгруженные present() с последнего takePresentedRects()
+    std::vector<Rectangle> presented_rects;
+    // упакованные в формат шины пиксели отправляемой области
+    const PixelFormatInfo* pixel_format;
+    std::vector<uint8_t> transfer_buffer;
+    std::vector<Span> span_buffer;
+    SPITransaction transaction;
+    // то, что сейчас показывает панель, в координатах экрана. выгрузка
+    // сравнивает с ней грязные области и шлёт только изменившиеся окна.
+    // пишет выгрузка, вне её - только при простаивающем потоке отправки.
+    // после сброса и поворота копия неизвестна, пока не выгружен весь экран
+    std::vector<uint16_t> shadow;
+    bool shadow_valid;
+    bool diff_flush;
+    FlushCostModel flush_cost;
+    FlushPlanner flush_planner;
+    std::vector<Rectangle> flush_windows;
+    DiffFlushStats diff_stats;
+    // последнее окно адресов: CASET/RASET с теми же границами не повторяем
+    int32_t window_columns;
+    int32_t window_rows;
+    // полоса вертикальной прокрутки [scroll_top, scroll_top + scroll_height).
+    // при аппаратной прокрутке строка экрана scroll_top + k лежит в памяти
+    // панели в строке scroll_top + (k + scroll_offset) % scroll_height
+    static constexpr int16_t GRAM_LINES = 162;
+    int16_t scroll_top;
+    int16_t scroll_height;
+    int16_t scroll_offset;
+    bool scroll_hardware;
     
-    void writeCommand(uint8_t cmd);
-    void writeData(const uint8_t* data, size_t length);
-    void setAddressWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
+    void writeCommand(uint8_t cmd, const uint8_t* params = nullptr, size_t length = 0);
+    void setAddressWindow(SPITransaction& txn, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
+    // асинхронный режим: поток отправки владеет SPI, рендер заполняет
+    // свободный из двух буферов и продолжает рисовать
+    struct FlushFrame {
+        std::vector<uint16_t> pixels;
+        std::vector<Rectangle> rects;
+        // события окна, изменения которых попали в кадр
+        TraceEventRange events;
+    };
+    FlushMode flush_mode;
+    FlushFrame frames[2];
+    int pending_frame;
+    int active_frame;
+    bool flush_running;
+    std::thread flush_thread;
+    std::mutex flush_mutex;
+    std::condition_variable flush_cv;
+    std::condition_variable idle_cv;
+    PerfCounters* perf;
+
+    void markDirty(int16_t x, int16_t y, int16_t w, int16_t h);
+    void clipAndMarkDirty(int16_t x, int16_t y, int16_t w, int16_t h);
+    // выгрузка грязных областей кадра с шагом строки width
+    void flushRects(const uint16_t* source, const std::vector<Rectangle>& rects);
+    void flushRect(const uint16_t* source, int stride, const Rectangle& rect);
+    // сдвиг строк полосы теневой копии вслед за сменой адреса прокрутки
+    void rotateShadowRows(int16_t top, int16_t height, int16_t shift);
+    // окно rect кадрового буфера в строки памяти панели начиная с gram_y
+    void flushWindow(const uint16_t* source, int stride, const Rectangle& rect, int16_t gram_y);
+    void writeScrollArea(int16_t top, int16_t height);
+    void writeScrollStart(int16_t line);
+    void flushLoop();
     
 public:
+    // панель на SPI Raspberry Pi (pigpio и libgpiod)
     TFTDisplay(int channel = 0, int reset_pin = 25, int dc_pin = 24, 
-               int width = 128, int height = 160);
+               int width = 128, int height = 160, FlushMode flush_mode = FlushMode::Sync,
+               PixelFormat pixel_format = PixelFormat::RGB565)
+        : TFTDisplay(makePigpioBackend(channel, SPI_SPEED, dc_pin, reset_pin),
+                     width, height, flush_mode, pixel_format) {}
+    // панель за произвольной шиной: приёмник для замеров, эмулятор
+    TFTDisplay(std::unique_ptr<SPIBackend> backend, int width, int height,
+               FlushMode flush_mode = FlushMode::Sync, PixelFormat pixel_format = PixelFormat::RGB565);
     ~TFTDisplay();
     
     bool init();
@@ -37,7 +126,58 @@ public:
     void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
     void drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
     void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+    void fillEllipse(int16_t x0, int16_t y0, int16_t rx, int16_t ry, uint16_t color);
+    // заливка набора горизонтальных отрезков: одна запись в память на отрезок
+    void fillSpans(const std::vector<Span>& spans, uint16_t color);
     void setFont(const Font& font);
+    // прозрачный текст: фон под глифами не меняется
     void drawText(int16_t x, int16_t y, const std::string& text, uint16_t color);
+    // текст на фоне: строка копируется из кэша глифов одним прямоугольником
+    void drawText(int16_t x, int16_t y, const std::string& text, uint16_t color, uint16_t bg);
+    const Font& getFont() const { return current_font; }
     void drawImage(int16_t x, int16_t y, int16_t w, int16_t h, const std::vector<uint16_t>& image_data);
+    // копирование области w x h из буфера с шагом строки stride
+    void blit(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t* pixels, int16_t stride);
+    // вывод .565: несжатые плитки RGB565 в порядке байт панели, целиком попадающие
+    // на экран, уходят в SPI прямо из отображённого файла, остальные
+    // распаковываются через кадровый буфер. рисует сразу, без present()
+    void drawImage(int16_t x, int16_t y, const Asset565& asset);
+
+    // вертикальная прокрутка полосы строк: VSCRDEF задаёт полосу, VSCSAD -
+    // строку памяти в её начале, так что сдвиг на строку стоит одной команды.
+    // аппаратно только без поворота (прокрутка идёт по строкам матрицы),
+    // иначе scrollUp перерисовывает полосу. false - прокрутка программная
+    bool setScrollArea(int16_t top, int16_t height);
+    // вернуть обычную адресацию памяти панели
+    void clearScrollArea();
+    // сдвинуть полосу вверх на lines строк, освободившиеся снизу залить fill
+    void scrollUp(int16_t lines, uint16_t fill);
+    bool hasHardwareScroll() const { return scroll_hardware; }
+
+    // отправка накопленных грязных областей на панель, по одному окну адресов на область
+    void present();
+    // ожидание, пока поток отправки не выгрузит все переданные кадры
+    void waitIdle();
+    bool hasPendingChanges() const { return !dirty_rects.empty(); }
+    // забрать области, изменившиеся на панели: для зеркал и превью,
+    // которым нужно обновлять только изменённые участки
+    bool takePresentedRects(std::vector<Rectangle>& rects);
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    PixelFormat getPixelFormat() const { return pixel_format->format; }
+    // байт на шине для pixels пикселей в текущем формате
+    size_t packedSize(size_t pixels) const { return pixel_format->packed_size(pixels); }
+    // содержимое кадрового буфера, шаг строки - getWidth()
+    const uint16_t* getPixels() const { return framebuffer.data(); }
+    const SPIStats& getSPIStats() const { return spi.getStats(); }
+    // счётчики производительности для дисплея и шины, nullptr - без замеров.
+    // задавать до init(): потом указатель читает поток отправки
+    void setPerfCounters(PerfCounters* perf) { this->perf = perf; spi.setPerfCounters(perf); }
+    void resetSPIStats() { spi.resetStats(); }
+    // false - грязные области уходят целиком, без сравнения с панелью
+    void setDiffFlush(bool enabled) { diff_flush = enabled; }
+    void setFlushCost(const FlushCostModel& cost) { flush_cost = cost; }
+    // в асинхронном режиме читать и сбрасывать после waitIdle()
+    const DiffFlushStats& getDiffFlushStats() const { return diff_stats; }
+    void resetDiffFlushStats() { diff_stats = DiffFlushStats(); }
 }; 
\ No newline at end of file
@@ -29,12 +29,24 @@ struct Rectangle {
         : x(x), y(y), width(width), height(height) {}
 };
 
-// структура шрифта
+// структура шрифта: глифы подряд с first_char по last_char, строка глифа
+// выровнена по байту, старший бит слева
 struct Font {
     uint8_t width;
     uint8_t height;
     const uint8_t* data;
+    char first_char;
+    char last_char;
     
-    Font(uint8_t width = 0, uint8_t height = 0, const uint8_t* data = nullptr)
-        : width(width), height(height), data(data) {}
+    Font(uint8_t width = 0, uint8_t height = 0, const uint8_t* data = nullptr,
+         char first_char = ' ', char last_char = '~')
+        : width(width), height(height), data(data),
+          first_char(first_char), last_char(last_char) {}
+
+    uint8_t rowBytes() const { return (width + 7) / 8; }
+
+    const uint8_t* glyph(char c) const {
+        if (!data || c < first_char || c > last_char) return nullptr;
+        return data + (c - first_char) * height * rowBytes();
+    }
 }; 
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "pixel_convert.h"
+#include <cstdint>
+#include <vector>
+
+// способ приведения 8-битных каналов к 5/6/5 битам
+enum class DitherMode {
+    None,           // отбрасывание младших бит
+    Bayer4,         // упорядоченное, матрица 4x4
+    Bayer8,         // упорядоченное, матрица 8x8
+    FloydSteinberg, // диффузия ошибки
+    Atkinson        // диффузия 3/4 ошибки, контрастнее на мелких деталях
+};
+
+// стадия сглаживания между декодером и RGB565. строки подаются по одной;
+// упорядоченные режимы зависят только от координат и идут через векторные
+// ядра pixel_convert, диффузия ошибки требует строк сверху вниз и хранит
+// ошибку только для двух следующих строк
+class Ditherer {
+public:
+    explicit Ditherer(DitherMode mode = DitherMode::None);
+
+    DitherMode getMode() const { return mode; }
+    bool isOrdered() const { return mode == DitherMode::Bayer4 || mode == DitherMode::Bayer8; }
+    bool isErrorDiffusion() const { return mode == DitherMode::FloydSteinberg || mode == DitherMode::Atkinson; }
+
+    // начало изображения: ширина строки и положение её левого края на экране
+    void begin(int width, int x_offset = 0);
+
+    // y - строка экрана; при диффузии ошибки пропуск строки сбрасывает ошибку
+    void bgr24Row(const uint8_t* src, uint16_t* dst, int y);
+    void bgrx32Row(const uint8_t* src, uint16_t* dst, int y);
+    // palette_bgr - 256 цветов по 3 байта B, G, R
+    void indexedRow(const uint8_t* indices, const uint8_t* palette_bgr, uint16_t* dst, int y);
+
+private:
+    DitherMode mode;
+    int width;
+    int x_offset;
+    int next_row;
+
+    pixel_convert::DitherBias bias;
+    // ошибка по каналам B, G, R, с полем в пиксель по краям: накопленная
+    // для текущей строки (по мере прохода заполняется ошибкой для y + 2)
+    // и для следующей
+    std::vector<int16_t> errors_current;
+    std::vector<int16_t> errors_next;
+    std::vector<uint8_t> bgr_row;
+
+    const pixel_convert::DitherBias* rowBias(int y);
+    template <int BPP>
+    void diffuseRow(const uint8_t* src, uint16_t* dst, int y);
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "raster.h"
+#include <cstdint>
+#include <vector>
+
+// какие соседи пикселя считаются связанными
+enum class FillConnectivity {
+    Four, // по стороне
+    Eight // по стороне и по диагонали
+};
+
+// заливка области построчно со стеком отрезков. работает по копии пикселей
+// панели (кадровому буферу) и ничего в неё не пишет: результат - отрезки
+// строк для fillSpans(), каждый пиксель области ровно в одном отрезке.
+// tolerance - наибольшая разница каждого канала с цветом под точкой в
+// 8-битной шкале, 0 - только точное совпадение.
+// отрезки дописываются в конец spans в порядке возрастания y, по одному
+// на непрерывный участок строки
+class FloodFill {
+public:
+    void fill(const uint16_t* pixels, int width, int height, int16_t x, int16_t y,
+              uint8_t tolerance, FillConnectivity connectivity, std::vector<Span>& spans);
+
+    // все пиксели, близкие к target, связные или нет (замена цвета фона)
+    static void replace(const uint16_t* pixels, int width, int height, uint16_t target,
+                        uint8_t tolerance, std::vector<Span>& spans);
+
+private:
+    // пиксели, уже попавшие в отрезки
+    std::vector<uint8_t> visited;
+    // строки, которые ещё надо просмотреть в диапазоне x0..x1
+    std::vector<Span> pending;
+};
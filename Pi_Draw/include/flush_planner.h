@@ -0,0 +1,63 @@
+#pragma once
+
+#include "display_types.h"
+#include "pixel_format.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// стоимость окна адресов на шине в байтах. кроме самих CASET/RASET/RAMWR
+// окно стоит вызовов драйвера: у каждой команды и каждого блока данных своё
+// переключение DC и своя запись в spidev, их время пересчитано в байты
+struct FlushCostModel {
+    // CASET и RASET с четырьмя байтами параметров и RAMWR
+    static constexpr size_t COMMAND_BYTES = 11;
+    // три команды и три блока данных
+    static constexpr size_t WINDOW_CALLS = 6;
+    // время одного вызова в байтах шины: около 8 мкс при 8 МГц
+    size_t call_bytes = 8;
+
+    size_t windowBytes() const { return COMMAND_BYTES + WINDOW_CALLS * call_bytes; }
+};
+
+// итоги выгрузки с поиском изменений. байты - оценка по FlushCostModel:
+// окно с теми же столбцами, что у предыдущего, на деле обходится без CASET
+struct DiffFlushStats {
+    uint64_t flushes = 0;
+    uint64_t rect_pixels = 0;    // пиксели грязных областей
+    uint64_t changed_pixels = 0; // из них отличались от показанного на панели
+    uint64_t sent_pixels = 0;    // ушли на шину вместе с промежутками внутри окон
+    uint64_t windows = 0;
+    uint64_t rect_bytes = 0;     // выгрузка грязных областей целиком
+    uint64_t sent_bytes = 0;     // выгрузка найденных окон
+
+    uint64_t savedBytes() const { return rect_bytes > sent_bytes ? rect_bytes - sent_bytes : 0; }
+};
+
+// раскладка изменений области по окнам адресов. строка области режется на
+// участки, отличающиеся от теневой копии; участки строки сливаются, если
+// промежуток дешевле нового окна, а участки соседних строк растят общее
+// окно, пока прирост пикселей дешевле отдельного окна
+class FlushPlanner {
+public:
+    // окна, покрывающие все пиксели rect, где source отличается от shadow
+    // (у обоих шаг строки stride), дописываются в windows.
+    // возвращает число отличающихся пикселей
+    size_t plan(const uint16_t* source, const uint16_t* shadow, int stride, const Rectangle& rect,
+                const PixelFormatInfo& format, const FlushCostModel& cost,
+                std::vector<Rectangle>& windows);
+
+private:
+    // x0..x1, y0..y1 включительно
+    struct Window {
+        int16_t x0;
+        int16_t x1;
+        int16_t y0;
+        int16_t y1;
+    };
+
+    std::vector<Window> runs;
+    // окна, дошедшие до предыдущей строки и до текущей
+    std::vector<Window> open;
+    std::vector<Window> next;
+};
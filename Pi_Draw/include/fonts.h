@@ -0,0 +1,42 @@
+#pragma once
+
+#include "display_types.h"
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// встроенные растровые шрифты, символы ASCII 32..126
+extern const Font FONT_5X7;
+extern const Font FONT_8X16;
+
+// глифы, заранее развёрнутые в RGB565 для пары цветов текст/фон:
+// вывод строки сводится к копированию готовых ячеек
+class GlyphCache {
+public:
+    explicit GlyphCache(size_t max_glyphs = 512);
+
+    // ячейка font.width x font.height, nullptr для символа вне шрифта
+    const uint16_t* get(const Font& font, char c, uint16_t fg, uint16_t bg);
+    void clear();
+    size_t size() const { return cells.size(); }
+
+private:
+    struct Key {
+        const uint8_t* font;
+        char c;
+        uint16_t fg;
+        uint16_t bg;
+
+        bool operator==(const Key& other) const {
+            return font == other.font && c == other.c && fg == other.fg && bg == other.bg;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    size_t max_glyphs;
+    std::unordered_map<Key, std::vector<uint16_t>, KeyHash> cells;
+};
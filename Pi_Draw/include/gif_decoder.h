@@ -0,0 +1,84 @@
+#pragma once
+
+#include "dither.h"
+#include "tools.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <gif_lib.h>
+
+// потоковое чтение GIF: кадры читаются по одному через DGifGetRecordType,
+// строки распаковываются DGifGetLine и сразу пересчитываются в RGB565 через
+// таблицу палитры. в памяти держится только одна строка кадра
+class GifDecoder {
+public:
+    struct Frame {
+        int16_t left = 0;
+        int16_t top = 0;
+        int16_t width = 0;
+        int16_t height = 0;
+        bool interlaced = false;
+        // из блока управления графикой, относится к этому кадру;
+        // до 65535 сотых секунды, в uint16_t не помещается
+        uint32_t delay_ms = 0;
+        uint8_t disposal = DISPOSAL_UNSPECIFIED;
+        int transparent_index = NO_TRANSPARENT_COLOR;
+    };
+
+    // y - строка логического экрана, indices/colors - width значений кадра
+    using RowHandler = std::function<void(int16_t y, const uint8_t* indices, const uint16_t* colors)>;
+
+    GifDecoder();
+    ~GifDecoder();
+
+    GifDecoder(const GifDecoder&) = delete;
+    GifDecoder& operator=(const GifDecoder&) = delete;
+
+    bool open(const std::string& filename);
+    void close();
+    bool isOpen() const { return gif != nullptr; }
+    // к первому кадру, для повтора анимации
+    bool rewind();
+
+    int16_t getWidth() const { return screen_width; }
+    int16_t getHeight() const { return screen_height; }
+    uint16_t getBackgroundColor() const { return background_color; }
+
+    // читает записи до описания следующего кадра; false - конец файла или ошибка
+    bool nextFrame(Frame& frame);
+    // распаковать строки кадра, найденного nextFrame
+    bool decodeFrame(const RowHandler& handler);
+    // пропустить сжатые данные кадра без распаковки
+    bool skipFrame();
+
+    // таблица цветов текущего кадра (локальная или глобальная палитра)
+    const uint16_t* getPalette() const { return palette; }
+
+    // сглаживание строк вместо прямой выборки из таблицы
+    void setDither(DitherMode mode);
+
+private:
+    GifFileType* gif;
+    std::string path;
+    int16_t screen_width;
+    int16_t screen_height;
+    uint16_t background_color;
+    uint16_t palette[256];
+    // та же палитра в 8 битах (B, G, R) для сглаживания
+    uint8_t palette_bgr[256 * 3];
+    Ditherer ditherer;
+    // диффузии ошибки нужны строки подряд, чересстрочные кадры сглаживаются матрицей
+    Ditherer interlaced_ditherer;
+    Frame current;
+    bool frame_pending;
+
+    std::vector<uint8_t> index_row;
+    std::vector<uint16_t> color_row;
+
+    void buildPalette(const ColorMapObject* map);
+    void reportError(const char* what);
+};
+
+// первый кадр на логическом экране, заполненном цветом фона
+bool loadGIF(const std::string& filename, ImageData& image, DitherMode dither = DitherMode::None);
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "display_pi.h"
+#include "gif_decoder.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// статистика воспроизведения для подбора анимаций под пропускную способность SPI
+struct GifPlaybackStats {
+    uint32_t frames_shown = 0;
+    uint32_t frames_dropped = 0;
+    // по последнему завершённому интервалу в одну секунду
+    float fps = 0.0f;
+    // средний объём отправки на показанный кадр: пиксели и команды окна
+    uint32_t bytes_per_frame = 0;
+};
+
+// проигрывание GIF на панели. кадры распаковываются по одному прямо в кадровый
+// буфер дисплея, на панель уходит только прямоугольник кадра (и область,
+// очищенная по методу утилизации предыдущего). если отправка не успевает за
+// задержками файла, просроченные кадры собираются в буфере без present(), и
+// их изменения уходят вместе со следующим показанным кадром
+class GifPlayer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit GifPlayer(TFTDisplay& display);
+
+    // x, y - положение логического экрана GIF на панели
+    bool open(const std::string& filename, int16_t x = 0, int16_t y = 0);
+    void stop();
+    bool isPlaying() const { return playing; }
+    void setLooping(bool loop) { looping = loop; }
+    // для анимации лучше упорядоченное: узор не «плывёт» между кадрами
+    void setDither(DitherMode mode) { decoder.setDither(mode); }
+
+    // вызывать из основного цикла: выводит кадры, время которых наступило.
+    // true, если на панель что-то отправлено
+    bool update(Clock::time_point now = Clock::now());
+    // время, до которого update() ничего не сделает
+    Clock::time_point nextFrameTime() const { return next_due; }
+
+    const GifPlaybackStats& getStats() const { return stats; }
+    void resetStats();
+
+private:
+    // задержки меньше этой браузеры заменяют на 100 мс, делаем так же
+    static constexpr uint32_t MIN_DELAY_MS = 20;
+    static constexpr uint32_t DEFAULT_DELAY_MS = 100;
+    // накладные расходы на окно: CASET, RASET, RAMWR с параметрами
+    static constexpr uint32_t WINDOW_OVERHEAD_BYTES = 11;
+
+    TFTDisplay& display;
+    GifDecoder decoder;
+    int16_t origin_x;
+    int16_t origin_y;
+    bool playing;
+    bool looping;
+
+    // утилизация предыдущего кадра выполняется перед выводом следующего
+    GifDecoder::Frame previous;
+    bool has_previous;
+    std::vector<uint16_t> saved_pixels;
+    std::vector<uint16_t> row_buffer;
+
+    Clock::time_point next_due;
+    // изменённая область с последнего present(), для учёта объёма отправки
+    Rectangle pending_rect;
+
+    GifPlaybackStats stats;
+    Clock::time_point fps_window_start;
+    uint32_t fps_window_frames;
+    uint64_t bytes_total;
+
+    bool composeNextFrame(uint32_t& delay_ms);
+    void disposePrevious();
+    // прямоугольник кадра на панели после обрезки; false - кадр вне панели
+    bool clipFrame(const GifDecoder::Frame& frame, int16_t& x0, int16_t& y0,
+                   int16_t& x1, int16_t& y1) const;
+    void extendPending(const Rectangle& rect);
+};
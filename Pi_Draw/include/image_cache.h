@@ -0,0 +1,101 @@
+#pragma once
+
+#include "dither.h"
+#include "tools.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// расширение файла без точки в нижнем регистре, "" если его нет; по нему
+// выбирают декодер и здесь, и в главном цикле
+std::string imageExtension(const std::string& filename);
+// декодированное изображение по расширению файла (bmp, gif - первый кадр, 565)
+bool loadImageFile(const std::string& filename, ImageData& image, DitherMode dither);
+// вписать в max_width x max_height с сохранением пропорций, ближайший сосед;
+// 0 - без изменений
+void scaleImageToFit(ImageData& image, uint16_t max_width, uint16_t max_height);
+
+// кэш готовых к выводу изображений RGB565. ключ - путь, время изменения
+// файла, целевой размер и способ преобразования, так что изменённый файл
+// или другой размер декодируются заново. объём ограничен budget_bytes,
+// вытесняются давно не использованные. соседние файлы каталога
+// подгружаются фоновым потоком, повторный выбор - поиск указателя
+class ImageCache {
+public:
+    using ImagePtr = std::shared_ptr<const ImageData>;
+
+    explicit ImageCache(size_t budget_bytes = 4 * 1024 * 1024);
+    ~ImageCache();
+
+    ImageCache(const ImageCache&) = delete;
+    ImageCache& operator=(const ImageCache&) = delete;
+
+    // max_width/max_height - вписать с сохранением пропорций, 0 - исходный размер
+    ImagePtr get(const std::string& path, uint16_t max_width = 0, uint16_t max_height = 0,
+                 DitherMode dither = DitherMode::None);
+    // поставить в очередь фоновой загрузки соседей path по алфавиту
+    void prefetchSiblings(const std::string& path, uint16_t max_width = 0, uint16_t max_height = 0,
+                          DitherMode dither = DitherMode::None);
+
+    void setBudget(size_t budget_bytes);
+    size_t getBudget() const;
+    size_t getUsedBytes() const;
+    size_t getHits() const;
+    size_t getMisses() const;
+    void clear();
+
+private:
+    static constexpr size_t PREFETCH_NEIGHBOURS = 2;
+
+    struct Key {
+        std::string path;
+        int64_t mtime_ns;
+        uint16_t max_width;
+        uint16_t max_height;
+        DitherMode dither;
+
+        bool operator==(const Key& other) const {
+            return mtime_ns == other.mtime_ns && max_width == other.max_width &&
+                   max_height == other.max_height && dither == other.dither && path == other.path;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        ImagePtr image;
+        size_t bytes;
+        std::list<Key>::iterator lru_position;
+    };
+
+    size_t budget;
+    size_t used_bytes;
+    size_t hits;
+    size_t misses;
+    // начало списка - последнее использованное
+    std::list<Key> lru;
+    std::unordered_map<Key, Entry, KeyHash> entries;
+    mutable std::mutex cache_mutex;
+
+    std::deque<Key> prefetch_queue;
+    bool prefetch_running;
+    std::thread prefetch_thread;
+    std::condition_variable prefetch_cv;
+
+    static bool makeKey(const std::string& path, uint16_t max_width, uint16_t max_height,
+                        DitherMode dither, Key& key);
+    static ImagePtr decode(const Key& key);
+    // под cache_mutex
+    void insert(const Key& key, const ImagePtr& image, bool most_recent);
+    void evict();
+    void prefetchLoop();
+};
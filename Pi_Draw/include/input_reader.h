@@ -0,0 +1,102 @@
+#pragma once
+
+#include "spsc_queue.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class InputEventType : uint8_t {
+    Key,         // байт с терминала
+    Arrow,       // стрелка на терминале: dx, dy
+    MouseMove,   // смещение мыши за один пакет устройства: dx, dy (y вниз)
+    MouseButton, // button, pressed
+    MouseWheel   // dy: +1 вверх, -1 вниз
+};
+
+enum class MouseButton : uint8_t { Left, Right, Middle };
+
+struct InputEvent {
+    InputEventType type = InputEventType::Key;
+    char key = 0;
+    MouseButton button = MouseButton::Left;
+    bool pressed = false;
+    int16_t dx = 0;
+    int16_t dy = 0;
+    // время получения по steady_clock
+    uint64_t time_ms = 0;
+};
+
+// поток ввода: ждёт в epoll терминал и мыши evdev (/dev/input/event*),
+// переводит их данные в InputEvent и кладёт в очередь без блокировок.
+// мыши, подключённые после start(), подхватываются через inotify на
+// /dev/input.
+// читатель очереди один - поток, которому принадлежит дисплей; о новых
+// событиях он узнаёт по eventfd wakeFd(). stop() прерывает ожидание
+// через отдельный eventfd, поэтому поток завершается сразу
+class InputReader {
+public:
+    static constexpr size_t QUEUE_SIZE = 1024;
+    // сколько ждать продолжения ESC, прежде чем считать его отдельной клавишей
+    static constexpr int ESCAPE_TIMEOUT_MS = 50;
+
+    InputReader();
+    ~InputReader();
+
+    InputReader(const InputReader&) = delete;
+    InputReader& operator=(const InputReader&) = delete;
+
+    // открыть устройства и запустить поток; терминал уже должен быть
+    // переведён в посимвольный режим
+    bool start();
+    void stop();
+
+    // становится читаемым, когда в очереди появились события
+    int wakeFd() const { return wake_fd; }
+    // сбросить eventfd; вызывать до разбора очереди, тогда событие,
+    // пришедшее во время разбора, взведёт его снова
+    void clearWakeup();
+    bool pop(InputEvent& event) { return queue.pop(event); }
+    // события, не поместившиеся в очередь
+    uint64_t droppedEvents() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Device {
+        int fd;
+        // /dev/input/eventN, чтобы не открыть устройство дважды
+        std::string path;
+        // накопленное до SYN_REPORT
+        int dx;
+        int dy;
+        int wheel;
+    };
+
+    SPSCQueue<InputEvent, QUEUE_SIZE> queue;
+    int epoll_fd;
+    int wake_fd;
+    int stop_fd;
+    // inotify на /dev/input, -1 если недоступен
+    int inotify_fd;
+    std::vector<Device> devices;
+    std::thread thread;
+    std::atomic<uint64_t> dropped;
+    // разбор ESC [ ... на терминале
+    int escape_state;
+    // когда пришёл ESC, ожидающий продолжения
+    uint64_t escape_time_ms;
+    // в очередь добавлены события, читатель ещё не разбужен
+    bool wakeup_pending;
+
+    void openDevices();
+    void openDevice(const std::string& name);
+    void readHotplug();
+    void closeAll();
+    void run();
+    bool readTerminal();
+    bool readDevice(Device& device);
+    void flushMotion(Device& device);
+    void push(InputEvent event);
+    void terminalByte(char byte);
+    void flushEscape();
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <ostream>
+
+// счётчики событий; пишутся из потока отправки и основного потока
+enum class PerfCounter {
+    SpiBytes,
+    SpiTransactions,
+    DcToggles,
+    WindowSetups,   // окна адресов, для которых ушли CASET/RASET
+    Flushes,        // выгрузки кадра на панель
+    DiffSavedBytes, // не отправлено благодаря сравнению с панелью (оценка)
+    Count
+};
+
+// измеряемые отрезки времени
+enum class PerfTiming {
+    SpiWrite, // ожидание в SPIBackend::write
+    Events,   // разбор событий окна вместе с рисованием в кадровый буфер
+    Render,   // отрисовка окна SFML
+    Flush,    // выгрузка кадра на панель
+    Count
+};
+
+constexpr size_t PERF_COUNTER_COUNT = static_cast<size_t>(PerfCounter::Count);
+constexpr size_t PERF_TIMING_COUNT = static_cast<size_t>(PerfTiming::Count);
+
+// гистограмма длительностей в наносекундах: четыре корзины на октаву,
+// погрешность перцентиля до 1/8. запись без блокировок из любого потока
+class PerfHistogram {
+public:
+    PerfHistogram() { reset(); }
+
+    void record(uint64_t ns);
+    // значения, попавшие в гистограмму после последнего reset()
+    uint64_t count() const { return samples.load(std::memory_order_relaxed); }
+    uint64_t total() const { return sum.load(std::memory_order_relaxed); }
+    // p от 0 до 1, 0 для пустой гистограммы
+    uint64_t percentile(double p) const;
+    // записи, идущие во время сброса, могут потеряться - для статистики допустимо
+    void reset();
+
+private:
+    static constexpr int SUB_BUCKETS = 4;
+    static constexpr int BUCKETS = 64 * SUB_BUCKETS;
+
+    std::atomic<uint32_t> buckets[BUCKETS];
+    std::atomic<uint64_t> samples;
+    std::atomic<uint64_t> sum;
+
+    static int bucketIndex(uint64_t ns);
+    // середина диапазона корзины
+    static uint64_t bucketValue(int index);
+};
+
+// итог за интервал (около секунды)
+struct PerfSample {
+    double time_s = 0;   // конец интервала от включения счётчиков
+    double seconds = 0;  // длина интервала
+    uint64_t counters[PERF_COUNTER_COUNT] = {};
+
+    struct Timing {
+        uint64_t count = 0;
+        uint64_t total_ns = 0;
+        uint64_t p50_ns = 0;
+        uint64_t p99_ns = 0;
+    };
+    Timing timings[PERF_TIMING_COUNT];
+
+    uint64_t counter(PerfCounter c) const { return counters[static_cast<size_t>(c)]; }
+    const Timing& timing(PerfTiming t) const { return timings[static_cast<size_t>(t)]; }
+};
+
+// счётчики производительности. выключенные стоят одной проверки флага
+// на месте замера; SPIDevice и TFTDisplay получают указатель через
+// setPerfCounters(), nullptr - без замеров вовсе
+class PerfCounters {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit PerfCounters(size_t max_history = 3600);
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    void add(PerfCounter counter, uint64_t value = 1) {
+        if (!isEnabled()) return;
+        counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+    }
+    void record(PerfTiming timing, uint64_t ns) {
+        if (!isEnabled()) return;
+        histograms[static_cast<size_t>(timing)].record(ns);
+    }
+
+    // вызывать из основного цикла: раз в interval подводит итог интервала,
+    // true - появился новый PerfSample
+    bool update(Clock::duration interval = std::chrono::seconds(1));
+    bool hasSamples() const { return !history.empty(); }
+    const PerfSample& getLast() const { return history.back(); }
+    const std::deque<PerfSample>& getHistory() const { return history; }
+
+    static const char* name(PerfCounter counter);
+    static const char* name(PerfTiming timing);
+    static void writeCSVHeader(std::ostream& out);
+    static void writeCSVRow(std::ostream& out, const PerfSample& sample);
+
+private:
+    std::atomic<bool> enabled;
+    std::atomic<uint64_t> counters[PERF_COUNTER_COUNT];
+    PerfHistogram histograms[PERF_TIMING_COUNT];
+    // значения счётчиков на начало интервала
+    uint64_t interval_start_counters[PERF_COUNTER_COUNT];
+    Clock::time_point enabled_at;
+    Clock::time_point interval_start;
+    size_t max_history;
+    std::deque<PerfSample> history;
+};
+
+// замер времени блока: часы читаются только при включённых счётчиках
+class PerfScope {
+public:
+    PerfScope(PerfCounters* perf, PerfTiming timing)
+        : perf(perf && perf->isEnabled() ? perf : nullptr), timing(timing) {
+        if (this->perf) start = PerfCounters::Clock::now();
+    }
+    ~PerfScope() {
+        if (perf) {
+            perf->record(timing, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                PerfCounters::Clock::now() - start).count());
+        }
+    }
+
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+    PerfCounters* perf;
+    PerfTiming timing;
+    PerfCounters::Clock::time_point start;
+};
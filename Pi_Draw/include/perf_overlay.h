@@ -0,0 +1,37 @@
+#ifndef PERF_OVERLAY_H
+#define PERF_OVERLAY_H
+
+#include "fonts.h"
+#include "perf_counters.h"
+#include <SFML/Graphics.hpp>
+#include <string>
+#include <vector>
+
+// Per-second performance stats drawn over the window corner. Text is
+// rendered with the panel's own 5x7 font, so no font file is needed, and
+// the texture is rebuilt only when a new sample arrives.
+class PerfOverlay {
+public:
+    explicit PerfOverlay(const PerfCounters& perf);
+    void setVisible(bool visible) { this->visible = visible; }
+    bool isVisible() const { return visible; }
+    void draw(sf::RenderWindow& window);
+
+private:
+    static constexpr int SCALE = 2;
+
+    const PerfCounters& perf;
+    bool visible;
+    // time of the sample the texture shows
+    double shownKey;
+    GlyphCache glyphs;
+    sf::Texture texture;
+    sf::Sprite sprite;
+    sf::RectangleShape background;
+    std::vector<sf::Uint8> pixels;
+
+    std::vector<std::string> formatLines(const PerfSample& sample) const;
+    void renderText(const std::vector<std::string>& lines);
+};
+
+#endif // PERF_OVERLAY_H
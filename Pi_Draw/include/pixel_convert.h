@@ -0,0 +1,30 @@
+#pragma once
+
+#include "colors.h"
+#include <cstddef>
+#include <cstdint>
+
+// пересчёт строк пикселей в RGB565. на ARM используется NEON, на x86 - SSE,
+// остаток строки и прочие платформы - скалярный код
+namespace pixel_convert {
+
+// добавки упорядоченного сглаживания для 16 пикселей строки подряд
+// (пиксель x берёт элемент x & 15): к 8-битным каналам прибавляются с
+// насыщением перед отбрасыванием младших бит
+struct DitherBias {
+    uint8_t rb[16]; // красный и синий, шаг квантования 8
+    uint8_t g[16];  // зелёный, шаг 4
+};
+
+inline uint16_t rgb565(uint8_t r, uint8_t g, uint8_t b) {
+    return RGB565(r, g, b);
+}
+
+// 3 байта на пиксель в порядке B, G, R (как в BMP)
+void bgr24ToRGB565(const uint8_t* src, uint16_t* dst, size_t count, const DitherBias* bias = nullptr);
+// 4 байта на пиксель в порядке B, G, R, X
+void bgrx32ToRGB565(const uint8_t* src, uint16_t* dst, size_t count, const DitherBias* bias = nullptr);
+// индексы палитры через готовую таблицу цветов
+void indexedToRGB565(const uint8_t* src, const uint16_t* lut, uint16_t* dst, size_t count);
+
+} // namespace pixel_convert
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// формат пикселей на шине (COLMOD). кадровый буфер всегда RGB565 в порядке
+// байт процессора: в нём рисуют примитивы, его читают зеркала и превью.
+// формат применяется только при упаковке областей перед отправкой
+enum class PixelFormat {
+    RGB444, // 12 бит, два пикселя в трёх байтах
+    RGB565, // 16 бит, старшим байтом вперёд
+    RGB666  // 18 бит, по байту на канал
+};
+
+// политики форматов: значение COLMOD, размер упакованных данных и упаковщик.
+// строки окна передаются подряд одним потоком, поэтому Packer принимает их
+// по очереди и хранит состояние между вызовами - у RGB444 пара пикселей
+// может начаться в конце одной строки и закончиться в следующей
+
+struct RGB444Format {
+    static constexpr PixelFormat FORMAT = PixelFormat::RGB444;
+    static constexpr uint8_t COLMOD = 0x03;
+    static constexpr size_t packedSize(size_t pixels) { return (pixels * 3 + 1) / 2; }
+
+    // старшие 4 бита каждого канала
+    static uint16_t to444(uint16_t c) {
+        return ((c >> 4) & 0xF00) | ((c >> 3) & 0x0F0) | ((c >> 1) & 0x00F);
+    }
+
+    class Packer {
+    public:
+        explicit Packer(uint8_t* dst) : out(dst), pending(0), has_pending(false) {}
+
+        void put(const uint16_t* src, size_t count) {
+            size_t i = 0;
+            if (has_pending && count > 0) {
+                writePair(pending, to444(src[0]));
+                has_pending = false;
+                i = 1;
+            }
+            for (; i + 1 < count; i += 2) {
+                writePair(to444(src[i]), to444(src[i + 1]));
+            }
+            if (i < count) {
+                pending = to444(src[i]);
+                has_pending = true;
+            }
+        }
+
+        // непарный последний пиксель: панель отбрасывает лишние полбайта
+        uint8_t* finish() {
+            if (has_pending) {
+                *out++ = pending >> 4;
+                *out++ = (pending & 0x0F) << 4;
+                has_pending = false;
+            }
+            return out;
+        }
+
+    private:
+        uint8_t* out;
+        uint16_t pending;
+        bool has_pending;
+
+        void writePair(uint16_t a, uint16_t b) {
+            out[0] = a >> 4;
+            out[1] = ((a & 0x0F) << 4) | (b >> 8);
+            out[2] = b & 0xFF;
+            out += 3;
+        }
+    };
+};
+
+struct RGB565Format {
+    static constexpr PixelFormat FORMAT = PixelFormat::RGB565;
+    static constexpr uint8_t COLMOD = 0x05;
+    static constexpr size_t packedSize(size_t pixels) { return pixels * 2; }
+
+    class Packer {
+    public:
+        explicit Packer(uint8_t* dst) : out(dst) {}
+
+        // перестановка байт, компилятор разворачивает цикл в векторный
+        void put(const uint16_t* src, size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                out[i * 2] = src[i] >> 8;
+                out[i * 2 + 1] = src[i] & 0xFF;
+            }
+            out += count * 2;
+        }
+
+        uint8_t* finish() { return out; }
+
+    private:
+        uint8_t* out;
+    };
+};
+
+struct RGB666Format {
+    static constexpr PixelFormat FORMAT = PixelFormat::RGB666;
+    static constexpr uint8_t COLMOD = 0x06;
+    static constexpr size_t packedSize(size_t pixels) { return pixels * 3; }
+
+    class Packer {
+    public:
+        explicit Packer(uint8_t* dst) : out(dst) {}
+
+        // панель берёт старшие 6 бит байта; младшие биты канала повторяют
+        // старшие, чтобы белый оставался белым
+        void put(const uint16_t* src, size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                uint16_t c = src[i];
+                out[i * 3] = ((c >> 8) & 0xF8) | (c >> 13);
+                out[i * 3 + 1] = ((c >> 3) & 0xFC) | ((c >> 9) & 0x03);
+                out[i * 3 + 2] = ((c << 3) & 0xF8) | ((c >> 2) & 0x07);
+            }
+            out += count * 3;
+        }
+
+        uint8_t* finish() { return out; }
+
+    private:
+        uint8_t* out;
+    };
+};
+
+// упаковка области width x height с шагом строки stride, возвращает число байт
+template <typename Format>
+size_t packRect(const uint16_t* src, int stride, int width, int height, uint8_t* dst) {
+    typename Format::Packer packer(dst);
+    if (width == stride) {
+        packer.put(src, static_cast<size_t>(width) * height);
+    } else {
+        for (int row = 0; row < height; row++) {
+            packer.put(src + static_cast<size_t>(row) * stride, width);
+        }
+    }
+    return packer.finish() - dst;
+}
+
+// формат, выбранный во время выполнения: указатели на экземпляры шаблонов
+struct PixelFormatInfo {
+    PixelFormat format;
+    uint8_t colmod;
+    size_t (*packed_size)(size_t pixels);
+    size_t (*pack_rect)(const uint16_t* src, int stride, int width, int height, uint8_t* dst);
+};
+
+template <typename Format>
+constexpr PixelFormatInfo makePixelFormatInfo() {
+    return {Format::FORMAT, Format::COLMOD, &Format::packedSize, &packRect<Format>};
+}
+
+inline const PixelFormatInfo& getPixelFormatInfo(PixelFormat format) {
+    static const PixelFormatInfo formats[] = {
+        makePixelFormatInfo<RGB444Format>(),
+        makePixelFormatInfo<RGB565Format>(),
+        makePixelFormatInfo<RGB666Format>(),
+    };
+    return formats[static_cast<int>(format)];
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "display_types.h"
+#include <cstdint>
+#include <vector>
+
+// горизонтальный отрезок строки y: пиксели x0..x1 включительно
+struct Span {
+    int16_t y;
+    int16_t x0;
+    int16_t x1;
+};
+
+// окончание толстой линии
+enum class LineCap {
+    Butt,  // срез по концевой точке
+    Round  // полукруг радиусом в половину толщины
+};
+
+// растеризация фигур в набор горизонтальных отрезков (по одному-два на строку),
+// отрезки дописываются в конец spans в порядке возрастания y
+namespace raster {
+
+void fillRect(int16_t x0, int16_t y0, int16_t x1, int16_t y1, std::vector<Span>& spans);
+void fillCircle(int16_t cx, int16_t cy, int16_t r, std::vector<Span>& spans);
+void fillEllipse(int16_t cx, int16_t cy, int16_t rx, int16_t ry, std::vector<Span>& spans);
+// кольцо эллипса толщиной width внутрь от внешнего контура
+void ellipseRing(int16_t cx, int16_t cy, int16_t rx, int16_t ry, int16_t width, std::vector<Span>& spans);
+
+// обводка без перекрытий: каждый пиксель попадает ровно в один отрезок,
+// число отрезков пропорционально площади, а не длине на квадрат толщины
+void strokeLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t width, LineCap cap,
+                std::vector<Span>& spans);
+// рамка толщиной width внутрь от прямоугольника (x0, y0)-(x1, y1)
+void strokeRect(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t width, std::vector<Span>& spans);
+void circleRing(int16_t cx, int16_t cy, int16_t r, uint8_t width, std::vector<Span>& spans);
+// ломаная одним проходом: звенья со скруглёнными стыками, концы - cap.
+// перекрытия звеньев сливаются, spans нормализуется целиком
+void strokePolyline(const std::vector<Point>& points, uint8_t width, LineCap cap,
+                    std::vector<Span>& spans);
+
+// сортировка по строкам и слияние перекрывающихся и смежных отрезков
+void normalizeSpans(std::vector<Span>& spans);
+
+} // namespace raster
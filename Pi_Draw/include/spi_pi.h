@@ -1,26 +1,103 @@
 #pragma once
 
+#include "perf_counters.h"
 #include <cstdint>
+#include <memory>
 #include <string>
-#include <gpiod.h>
-#include <pigpio.h>
+#include <vector>
+
+// счётчики обращений к шине
+struct SPIStats {
+    uint64_t segments = 0;   // сегменты команд/данных в транзакциях
+    uint64_t bytes = 0;      // байты, ушедшие по SPI
+    uint64_t spi_writes = 0; // вызовы spiWrite
+    uint64_t dc_writes = 0;  // переключения линии DC
+    uint64_t transactions = 0; // вызовы SPIDevice::submit
+
+    uint64_t syscalls() const { return spi_writes + dc_writes; }
+    // время передачи данных по шине на частоте clock_hz, без пауз между вызовами
+    double busTimeUs(uint32_t clock_hz) const { return bytes * 8.0 * 1e6 / clock_hz; }
+};
+
+// шина панели: SPI и линии DC/RST. SPIDevice ведёт счётчики и кэширует
+// уровень DC, реализация только передаёт байты и переключает линии
+class SPIBackend {
+public:
+    virtual ~SPIBackend() = default;
+
+    virtual bool init() = 0;
+    // false - ошибка передачи
+    virtual bool write(const uint8_t* data, size_t length) = 0;
+    virtual void setDC(bool state) = 0;
+    virtual void setRST(bool state) = 0;
+    virtual void delay(uint32_t ms) = 0;
+};
+
+// приёмник без железа: данные отбрасываются, паузы не выдерживаются.
+// для замеров по счётчикам SPIDevice
+class SPISink : public SPIBackend {
+public:
+    bool init() override { return true; }
+    bool write(const uint8_t*, size_t) override { return true; }
+    void setDC(bool) override {}
+    void setRST(bool) override {}
+    void delay(uint32_t) override {}
+};
+
+// SPI через pigpio, DC и RST через libgpiod (spi_pigpio.cpp)
+std::unique_ptr<SPIBackend> makePigpioBackend(int channel, int speed, int dc_pin, int rst_pin);
+
+// последовательность сегментов команда/данные, отправляемая одним вызовом
+// SPIDevice::submit(); соседние сегменты с одинаковым уровнем DC склеиваются
+class SPITransaction {
+public:
+    void command(uint8_t cmd);
+    void command(uint8_t cmd, const uint8_t* params, size_t length);
+    void data(const uint8_t* data, size_t length);
+    // данные без копирования: буфер должен жить до окончания submit()
+    void dataRef(const uint8_t* data, size_t length);
+    void clear();
+
+    bool empty() const { return segments.empty(); }
+    size_t segmentCount() const { return segments.size(); }
+    size_t recordedSegments() const { return recorded; }
+
+private:
+    friend class SPIDevice;
+
+    struct Segment {
+        bool dc;
+        const uint8_t* external;
+        size_t offset;
+        size_t length;
+    };
+
+    std::vector<uint8_t> buffer;
+    std::vector<Segment> segments;
+    size_t recorded = 0;
+
+    void append(bool dc, const uint8_t* data, size_t length);
+};
 
 class SPIDevice {
 private:
-    int spi_channel;
-    int spi_speed;
-    int spi_handle;
-    struct gpiod_chip *chip;
-    struct gpiod_line *dc_line;
-    struct gpiod_line *rst_line;
+    std::unique_ptr<SPIBackend> backend;
+    int dc_state;
+    SPIStats stats;
+    PerfCounters* perf;
     
 public:
-    SPIDevice(int channel = 0, int speed = 8000000);
-    ~SPIDevice();
+    explicit SPIDevice(std::unique_ptr<SPIBackend> backend);
     
     bool init();
-    void write(uint8_t* data, size_t length);
+    void write(const uint8_t* data, size_t length);
+    void submit(const SPITransaction& transaction);
     void setDC(bool state);
     void setRST(bool state);
     void delay(uint32_t ms);
-}; 
\ No newline at end of file
+
+    // счётчики производительности, nullptr - без замеров
+    void setPerfCounters(PerfCounters* perf) { this->perf = perf; }
+    const SPIStats& getStats() const { return stats; }
+    void resetStats() { stats = SPIStats(); }
+};
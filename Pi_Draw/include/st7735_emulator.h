@@ -0,0 +1,134 @@
+#pragma once
+
+#include "pixel_format.h"
+#include "spi_pi.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// счётчики эмулятора
+struct EmulatorStats {
+    uint64_t commands = 0;            // принятые команды
+    uint64_t pixels = 0;              // пиксели, записанные RAMWR
+    uint64_t unchanged_pixels = 0;    // из них совпавшие с содержимым памяти
+    uint64_t out_of_range_pixels = 0; // пиксели за пределами памяти панели
+    uint64_t protocol_errors = 0;     // неизвестные команды, лишние и недостающие параметры
+    uint64_t timing_violations = 0;   // команды раньше положенной паузы
+    uint64_t bus_ns = 0;              // время передачи на шине
+    uint64_t delay_ns = 0;            // паузы через delay()
+
+    double busTimeUs() const { return bus_ns / 1000.0; }
+};
+
+// что сохранять в картинку
+enum class EmulatorView {
+    Panel, // видимое на стекле: прокрутка, инверсия, сон и выключение
+    GRAM   // память панели как есть, 132x162
+};
+
+// программная модель ST7735S на месте шины: разбирает поток команд и данных
+// в память панели, так что TFTDisplay и Canvas работают без железа.
+// учитывает COLMOD, MADCTL (MX/MY/MV и порядок BGR), окно CASET/RASET
+// с переходом на следующую строку и возвратом в начало окна, прокрутку
+// VSCRDEF/VSCSAD, частичный режим, инверсию, сон и паузы после сброса.
+// время шины считается по частоте clock_hz, delay() только двигает часы.
+//
+// упрощения: видимая матрица width x height лежит в начале памяти без
+// смещений, отражения MX/MY считаются относительно неё; команды чтения
+// принимаются и ничего не возвращают. состояние читать после present()
+// и waitIdle() - в асинхронном режиме в эмулятор пишет поток отправки
+class ST7735Emulator : public SPIBackend {
+public:
+    static constexpr int GRAM_WIDTH = 132;
+    static constexpr int GRAM_HEIGHT = 162;
+
+    explicit ST7735Emulator(uint32_t clock_hz = 8000000, int width = 128, int height = 160);
+
+    bool init() override;
+    bool write(const uint8_t* data, size_t length) override;
+    void setDC(bool state) override { dc = state; }
+    void setRST(bool state) override;
+    void delay(uint32_t ms) override;
+
+    // сообщения о нарушениях протокола в std::cerr
+    void setVerbose(bool verbose) { this->verbose = verbose; }
+    void setClock(uint32_t clock_hz) { this->clock_hz = clock_hz; }
+    uint32_t getClock() const { return clock_hz; }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    // цвет точки стекла в физических координатах, 0xRRGGBB
+    uint32_t panelPixel(int x, int y) const;
+    // ячейка памяти панели, 0xRRGGBB
+    uint32_t gramPixel(int x, int y) const;
+    // видимый цвет точки с адресом (x, y) при текущем MADCTL, в RGB565:
+    // для сравнения с кадровым буфером TFTDisplay
+    uint16_t screenPixel565(int x, int y) const;
+    // цвет RGB565 после записи в формате format и обратного чтения
+    static uint16_t quantize565(uint16_t color, PixelFormat format);
+
+    // сохранение в бинарный PPM (P6)
+    bool savePPM(const std::string& filename, EmulatorView view = EmulatorView::Panel) const;
+
+    const EmulatorStats& getStats() const { return stats; }
+    void resetStats() { stats = EmulatorStats(); }
+    // время с создания эмулятора: передача плюс паузы
+    uint64_t getElapsedNs() const { return now_ns; }
+
+private:
+    uint32_t clock_hz;
+    int width;
+    int height;
+    bool verbose;
+    EmulatorStats stats;
+
+    // ячейки памяти по 18 бит: R6 G6 B6
+    std::vector<uint32_t> gram;
+
+    bool dc;
+    bool in_reset;
+    uint64_t now_ns;
+    // до этого момента панель не принимает команды
+    uint64_t ready_ns;
+    // до этого момента нельзя переключать сон (SLPIN/SLPOUT)
+    uint64_t sleep_ready_ns;
+
+    // разбор команды
+    uint8_t command;
+    bool has_command;
+    uint8_t params[16];
+    size_t param_count;
+    size_t param_expected;
+
+    // регистры
+    bool sleeping;
+    bool display_on;
+    bool inverted;
+    bool idle;
+    bool partial;
+    bool scrolling;
+    uint8_t colmod;
+    uint8_t madctl;
+    uint16_t column_start, column_end;
+    uint16_t row_start, row_end;
+    uint16_t partial_start, partial_end;
+    uint16_t scroll_top, scroll_height, scroll_start;
+
+    // запись в память: счётчик адреса и недособранный пиксель
+    bool ram_write;
+    uint16_t column, row;
+    uint8_t pixel_bytes[3];
+    size_t pixel_byte_count;
+
+    void reset();
+    void beginCommand(uint8_t cmd);
+    void executeCommand();
+    void writeData(uint8_t byte);
+    void writePixel(uint32_t value);
+    void protocolError(const std::string& message);
+    // физические координаты адреса (column, row) при текущем MADCTL
+    bool mapAddress(int column, int row, int& x, int& y) const;
+    // строка памяти, показываемая в строке стекла y
+    int displayLine(int y) const;
+    uint32_t shownPixel(int x, int y) const;
+};
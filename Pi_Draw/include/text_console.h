@@ -0,0 +1,52 @@
+#pragma once
+
+#include "colors.h"
+#include "display_pi.h"
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// текстовая консоль на полосе экрана с аппаратной прокруткой: новая строка
+// стоит одной команды VSCSAD и вывода одной строки текста вместо
+// перерисовки всего экрана. строки хранятся в буфере, длинные переносятся.
+// вывод накапливается в кадровом буфере и уходит на панель с present()
+class TextConsole {
+public:
+    // полоса от строки экрана top; rows = 0 - до низа экрана
+    TextConsole(TFTDisplay& display, int16_t top = 0, int16_t rows = 0);
+
+    // шрифт берётся у дисплея в момент открытия
+    bool open();
+    void close();
+    bool isOpen() const { return is_open; }
+
+    void setColors(uint16_t fg, uint16_t bg);
+    void print(const std::string& text);
+    // '\n' - новая строка, '\r' - в начало строки, '\b' - стереть символ, '\t' - табуляция
+    void putChar(char c);
+    void clear();
+
+    int16_t getRows() const { return rows; }
+    int16_t getColumns() const { return columns; }
+    // видимые строки сверху вниз, последняя - текущая
+    const std::deque<std::string>& getLines() const { return lines; }
+
+private:
+    static constexpr int16_t LINE_SPACING = 1;
+    static constexpr int16_t TAB_WIDTH = 4;
+
+    TFTDisplay& display;
+    int16_t top;
+    int16_t requested_rows;
+    int16_t rows;
+    int16_t columns;
+    int16_t line_height;
+    uint16_t fg;
+    uint16_t bg;
+    std::deque<std::string> lines;
+    bool is_open;
+
+    void newLine();
+    void drawCell(int16_t row, int16_t column, char c);
+    int16_t rowY(int16_t row) const { return top + row * line_height; }
+};
@@ -2,6 +2,7 @@
 #define TOOL_PANEL_H
 
 #include "tools.h"
+#include "image_cache.h"
 #include <SFML/Graphics.hpp>
 #include <vector>
 #include <functional>
@@ -13,8 +14,12 @@ public:
     void draw(sf::RenderWindow& window);
     void handleEvent(const sf::Event& event, DrawingProperties& props);
     bool loadImage(const std::string& filename, DrawingProperties& props);
+    // picked images are scaled to fit this size, 0 keeps the original size
+    void setImageTargetSize(uint16_t width, uint16_t height);
 
 private:
+    static constexpr int FILL_TOLERANCE_STEP = 8;
+
     struct ToolButton {
         sf::RectangleShape shape;
         Tool tool;
@@ -33,12 +38,13 @@ private:
     float sliderValue;
     sf::Text toolText;
     sf::Font font;
+    ImageCache imageCache;
+    uint16_t imageTargetWidth;
+    uint16_t imageTargetHeight;
 
     void initializeButtons();
     void initializeColorPalette();
     void updateSlider(float value);
-    bool loadBMP(const std::string& filename, ImageData& imageData);
-    bool loadGIF(const std::string& filename, ImageData& imageData);
 };
 
 #endif // TOOL_PANEL_H 
\ No newline at end of file
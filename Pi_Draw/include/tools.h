@@ -2,7 +2,11 @@
 #define TOOLS_H
 
 #include "colors.h"
+#include "dither.h"
+#include "display_types.h"
+#include "flood_fill.h"
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -10,17 +14,14 @@ enum class Tool {
     Rectangle,
     Line,
     Circle,
+    Ellipse,
     Pencil,
     Eraser,
-    Background,
+    Fill,       // flood fill of the area under the click
+    Background, // recolours every background pixel, joined or not
     Image
 };
 
-struct Point {
-    int16_t x;
-    int16_t y;
-};
-
 struct ImageData {
     std::vector<uint16_t> pixels;
     uint16_t width;
@@ -37,7 +38,15 @@ public:
     Point endPoint = {0, 0};
     bool isDrawing = false;
     uint16_t backgroundColor = COLOR_WHITE;
-    ImageData backgroundImage;
+    // Fill and Background: largest per-channel difference on the 0-255 scale
+    uint8_t fillTolerance = 0;
+    FillConnectivity fillConnectivity = FillConnectivity::Four;
+    // shared with the image cache, never modified; null for .565 assets
+    std::shared_ptr<const ImageData> backgroundImage;
+    std::string imagePath;
+    // bumped on every pick, also when the same file is picked again
+    unsigned imageRevision = 0;
+    DitherMode ditherMode = DitherMode::FloydSteinberg;
     bool hasBackgroundImage = false;
 };
 
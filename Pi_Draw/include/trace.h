@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// трассировка задержки от события окна до выгрузки на панель в формате
+// Chrome trace (chrome://tracing, ui.perfetto.dev). отрезки пишутся в
+// кольцевой буфер своего потока, saveTrace() сохраняет их по запросу.
+// без PI_DRAW_TRACE (опция CMake) макросы ниже ничего не делают.
+//
+// каждое событие окна получает номер; отрезки несут номер события, которое
+// обрабатывал поток, а кадр, переданный потоку отправки, - диапазон событий,
+// изменения которых в него попали. в файле от события к выгрузке идёт
+// стрелка потока, у выгрузки есть аргумент input_to_flush_us
+
+// события, изменения которых попали в кадр
+struct TraceEventRange {
+    uint64_t first = 0;
+    uint64_t last = 0;
+    // время получения первого события
+    uint64_t first_ns = 0;
+
+    bool empty() const { return first == 0; }
+    void add(uint64_t event, uint64_t event_ns);
+    void clear() { *this = TraceEventRange(); }
+};
+
+// время по steady_clock в наносекундах
+uint64_t traceNow();
+// новое событие окна: номер для TraceEventTag и начало стрелки к выгрузке
+uint64_t traceBeginEvent();
+void traceSetEvent(uint64_t event, uint64_t event_ns);
+uint64_t traceCurrentEvent();
+uint64_t traceCurrentEventTime();
+// завершённый отрезок; name должен жить до saveTrace() (строковый литерал)
+void traceSpan(const char* name, uint64_t start_ns, uint64_t end_ns,
+               const char* arg_name = nullptr, uint64_t arg = 0);
+// выгрузка кадра: отрезок со стрелками от событий диапазона
+void traceFlush(const char* name, uint64_t start_ns, uint64_t end_ns, const TraceEventRange& events);
+// имя потока в файле трассировки
+void traceSetThreadName(const char* name);
+// сохранить содержимое кольцевых буферов всех потоков
+bool saveTrace(const std::string& filename);
+
+// отрезок на время жизни объекта
+class TraceScope {
+public:
+    explicit TraceScope(const char* name, const char* arg_name = nullptr, uint64_t arg = 0)
+        : name(name), arg_name(arg_name), arg(arg), start(traceNow()) {}
+    ~TraceScope() { traceSpan(name, start, traceNow(), arg_name, arg); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    const char* arg_name;
+    uint64_t arg;
+    uint64_t start;
+};
+
+// событие, текущее для потока на время жизни объекта
+class TraceEventTag {
+public:
+    TraceEventTag(uint64_t event, uint64_t event_ns)
+        : saved(traceCurrentEvent()), saved_ns(traceCurrentEventTime()) {
+        traceSetEvent(event, event_ns);
+    }
+    ~TraceEventTag() { traceSetEvent(saved, saved_ns); }
+
+    TraceEventTag(const TraceEventTag&) = delete;
+    TraceEventTag& operator=(const TraceEventTag&) = delete;
+
+private:
+    uint64_t saved;
+    uint64_t saved_ns;
+};
+
+// обработка нового события окна: номер события и отрезок "sf::Event"
+class TraceInputEvent {
+public:
+    explicit TraceInputEvent(int type)
+        : start(traceNow()), tag(traceBeginEvent(), start), scope("sf::Event", "type", type) {}
+
+private:
+    uint64_t start;
+    TraceEventTag tag;
+    TraceScope scope;
+};
+
+// выгрузка кадра с событиями events; диапазон должен жить до конца блока
+class TraceFlushScope {
+public:
+    TraceFlushScope(const char* name, const TraceEventRange& events)
+        : name(name), events(events), start(traceNow()) {}
+    ~TraceFlushScope() { traceFlush(name, start, traceNow(), events); }
+
+    TraceFlushScope(const TraceFlushScope&) = delete;
+    TraceFlushScope& operator=(const TraceFlushScope&) = delete;
+
+private:
+    const char* name;
+    const TraceEventRange& events;
+    uint64_t start;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#ifdef PI_DRAW_TRACE
+constexpr bool TRACE_ENABLED = true;
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_SCOPE_ARG(name, arg_name, arg) \
+    TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name, arg_name, arg)
+// до конца блока идёт обработка события окна типа type
+#define TRACE_INPUT_EVENT(type) TraceInputEvent TRACE_CONCAT(trace_event_, __LINE__)(type)
+// добавить текущее событие потока в диапазон кадра
+#define TRACE_EVENT_RANGE_ADD(range) (range).add(traceCurrentEvent(), traceCurrentEventTime())
+// до конца блока текущим считается последнее событие диапазона
+#define TRACE_EVENT_RANGE_TAG(range) \
+    TraceEventTag TRACE_CONCAT(trace_tag_, __LINE__)((range).last, (range).first_ns)
+#define TRACE_FLUSH(name, range) TraceFlushScope TRACE_CONCAT(trace_flush_, __LINE__)(name, range)
+#define TRACE_THREAD_NAME(name) traceSetThreadName(name)
+#else
+constexpr bool TRACE_ENABLED = false;
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SCOPE_ARG(name, arg_name, arg) ((void)0)
+#define TRACE_INPUT_EVENT(type) ((void)0)
+#define TRACE_EVENT_RANGE_ADD(range) ((void)0)
+#define TRACE_EVENT_RANGE_TAG(range) ((void)0)
+#define TRACE_FLUSH(name, range) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
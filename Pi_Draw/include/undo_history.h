@@ -0,0 +1,97 @@
+#pragma once
+
+#include "display_pi.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// история отмены для рисования кистью: мазки хранятся как дельты точек,
+// периодически сохраняются контрольные копии изменённых тайлов кадра.
+// отмена восстанавливает тайлы от ближайшей контрольной точки и
+// проигрывает не больше checkpoint_interval действий - время не зависит
+// от длины сеанса, память ограничена budget_bytes
+class UndoHistory {
+public:
+    UndoHistory(TFTDisplay& display, size_t budget_bytes = 512 * 1024,
+                size_t checkpoint_interval = 16);
+
+    // отпечаток кисти: размер 1 - пиксель, иначе круг радиусом size - 1
+    static void stampBrush(TFTDisplay& display, int16_t x, int16_t y, uint8_t size, uint16_t color);
+
+    void beginStroke(uint16_t color, uint8_t brush_size);
+    // false, если точка совпадает с предыдущей и рисовать её не нужно
+    bool addPoint(int16_t x, int16_t y);
+    void endStroke();
+    bool inStroke() const { return stroke_open; }
+
+    void recordClear(uint16_t color);
+    // полоса строк [y, y + height) изменена в обход истории (текстовая
+    // консоль): её пиксели сохраняются как действие, иначе отмена вернёт
+    // тайлы контрольной точки поверх этого вывода
+    void recordSnapshot(int16_t y, int16_t height);
+
+    bool undo();
+    bool redo();
+    bool canUndo() const { return position > checkpoints.front().action; }
+    bool canRedo() const { return position < first_action + actions.size(); }
+
+    size_t memoryUsage() const { return memory_used; }
+
+private:
+    static constexpr int TILE_SIZE = 16;
+    // признак абсолютных координат в потоке дельт
+    static constexpr int8_t DELTA_ESCAPE = -128;
+
+    enum class ActionType {
+        Stroke,
+        Clear,
+        Snapshot
+    };
+
+    struct Action {
+        ActionType type;
+        uint16_t color;
+        uint8_t brush_size;
+        int16_t last_x;
+        int16_t last_y;
+        size_t point_count;
+        std::vector<int8_t> deltas;
+        // Snapshot: строки от last_y на всю ширину кадра
+        std::vector<uint16_t> pixels;
+        std::vector<bool> tiles;
+    };
+
+    // состояние кадра после action действий: только тайлы, изменённые
+    // с предыдущей контрольной точки (в базовой - все тайлы)
+    struct Checkpoint {
+        size_t action;
+        std::vector<int> tile_ids;
+        std::vector<uint16_t> pixels;
+    };
+
+    TFTDisplay& display;
+    size_t budget_bytes;
+    size_t checkpoint_interval;
+    int tiles_x;
+    int tiles_y;
+
+    std::deque<Action> actions;
+    size_t first_action;
+    size_t position;
+    std::vector<Checkpoint> checkpoints;
+    bool stroke_open;
+    size_t memory_used;
+
+    void pushAction(Action&& action);
+    void truncateRedo();
+    void markTiles(Action& action, int16_t x, int16_t y) const;
+    void replay(const Action& action);
+    void takeCheckpoint();
+    void captureTiles(Checkpoint& checkpoint, const std::vector<bool>& tiles) const;
+    void restoreTile(int tile, size_t checkpoint_index);
+    void enforceBudget();
+    size_t actionBytes(const Action& action) const;
+    size_t checkpointBytes(const Checkpoint& checkpoint) const;
+    const Action& actionAt(size_t index) const { return actions[index - first_action]; }
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "display_types.h"
+#include <cstdint>
+#include <vector>
+// в Xlib есть свой тип Font, под этим именем у нас шрифт
+#define Font XFont
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#undef Font
+
+// окно-зеркало панели на X-сервере. получает кадровый буфер RGB565 и список
+// изменённых областей, переводит в формат визуала только эти области и
+// выводит их с целым увеличением через MIT-SHM (или XPutImage, если
+// разделяемая память недоступна). без изменений окно не трогается
+class X11Mirror {
+private:
+    int width;
+    int height;
+    int zoom;
+    Display* x_display;
+    Window window;
+    GC gc;
+    XImage* x_image;
+    XShmSegmentInfo shm_info;
+    bool use_shm;
+    bool needs_full_update;
+
+    // RGB565 -> пиксель визуала: компоненты переводятся по отдельности
+    uint32_t red_lut[32];
+    uint32_t green_lut[64];
+    uint32_t blue_lut[32];
+
+    bool createShmImage(Visual* visual, int depth);
+    bool createImage(Visual* visual, int depth);
+    void buildColorTables(const Visual* visual);
+    void convertRect(const uint16_t* pixels, int stride, const Rectangle& rect);
+    void putRect(const Rectangle& rect);
+    void processEvents();
+    void release();
+
+public:
+    X11Mirror(int width = 128, int height = 160, int zoom = 1);
+    ~X11Mirror();
+
+    X11Mirror(const X11Mirror&) = delete;
+    X11Mirror& operator=(const X11Mirror&) = delete;
+
+    bool open(const char* title);
+    bool isOpen() const { return x_display != nullptr; }
+    bool usesShm() const { return use_shm; }
+    // сокет X-сервера для poll: окно ждёт Expose вместе с остальным вводом
+    int connectionFd() const { return x_display ? ConnectionNumber(x_display) : -1; }
+    // события, которые Xlib уже прочитал из сокета (например, во время
+    // XSync в update()): poll по connectionFd() о них не сообщит
+    bool hasQueuedEvents() const { return x_display && XEventsQueued(x_display, QueuedAlready) > 0; }
+
+    // вывести изменённые области; pixels - кадр width x height с шагом stride
+    void update(const uint16_t* pixels, int stride, const std::vector<Rectangle>& rects);
+};
@@ -0,0 +1,303 @@
+#include "asset565.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+constexpr size_t HEADER_SIZE = 16;
+constexpr uint8_t VERSION = 1;
+constexpr uint16_t RLE_RUN = 0x8000;
+constexpr size_t RLE_MAX_COUNT = 0x8000;
+// повтор короче трёх пикселей не короче литерала
+constexpr size_t RLE_MIN_RUN = 3;
+
+uint16_t readU16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+uint32_t readU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void putU16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(value & 0xFF);
+    out.push_back(value >> 8);
+}
+
+void putU32(std::vector<uint8_t>& out, uint32_t value) {
+    putU16(out, value & 0xFFFF);
+    putU16(out, value >> 16);
+}
+
+void putPixel(std::vector<uint8_t>& out, uint16_t pixel, bool big_endian) {
+    if (big_endian) {
+        out.push_back(pixel >> 8);
+        out.push_back(pixel & 0xFF);
+    } else {
+        out.push_back(pixel & 0xFF);
+        out.push_back(pixel >> 8);
+    }
+}
+
+uint16_t getPixel(const uint8_t* p, bool big_endian) {
+    return big_endian ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+}
+
+void encodeRLE(const std::vector<uint16_t>& pixels, bool big_endian, std::vector<uint8_t>& out) {
+    size_t i = 0;
+    while (i < pixels.size()) {
+        size_t run = 1;
+        while (i + run < pixels.size() && run < RLE_MAX_COUNT && pixels[i + run] == pixels[i]) {
+            run++;
+        }
+        if (run >= RLE_MIN_RUN) {
+            putU16(out, RLE_RUN | (run - 1));
+            putPixel(out, pixels[i], big_endian);
+            i += run;
+            continue;
+        }
+
+        // литерал до начала следующего повтора
+        size_t start = i;
+        while (i < pixels.size() && i - start < RLE_MAX_COUNT) {
+            if (i + RLE_MIN_RUN <= pixels.size() &&
+                pixels[i] == pixels[i + 1] && pixels[i] == pixels[i + 2]) {
+                break;
+            }
+            i++;
+        }
+        putU16(out, i - start - 1);
+        for (size_t j = start; j < i; j++) {
+            putPixel(out, pixels[j], big_endian);
+        }
+    }
+}
+
+} // namespace
+
+bool Asset565::open(const std::string& filename) {
+    close();
+
+    std::unique_ptr<MappedFile> mapped(new MappedFile(filename));
+    if (!mapped->data) {
+        std::cerr << "Failed to open 565 file: " << filename << std::endl;
+        return false;
+    }
+
+    const uint8_t* data = mapped->data;
+    if (mapped->size < HEADER_SIZE || std::memcmp(data, "R565", 4) != 0 || data[4] != VERSION) {
+        std::cerr << "Not a 565 file: " << filename << std::endl;
+        return false;
+    }
+
+    width = readU16(data + 6);
+    height = readU16(data + 8);
+    flags = data[5];
+    tile_width = readU16(data + 10);
+    tile_height = readU16(data + 12);
+    if (width == 0 || height == 0 || width > INT16_MAX || height > INT16_MAX) {
+        std::cerr << "Invalid 565 image size: " << filename << std::endl;
+        return false;
+    }
+    if (tile_width == 0 || tile_width > width) tile_width = width;
+    if (tile_height == 0 || tile_height > height) tile_height = height;
+    tiles_x = (width + tile_width - 1) / tile_width;
+    tiles_y = (height + tile_height - 1) / tile_height;
+
+    pixel_data = data + HEADER_SIZE;
+    pixel_size = mapped->size - HEADER_SIZE;
+    offsets = nullptr;
+
+    if (isRLE()) {
+        size_t table_size = (getTileCount() + 1) * 4;
+        if (pixel_size < table_size) {
+            std::cerr << "Truncated 565 file: " << filename << std::endl;
+            return false;
+        }
+        offsets = pixel_data;
+        pixel_data += table_size;
+        pixel_size -= table_size;
+
+        // смещения проверяем один раз, дальше плитки читаются без проверок границ
+        uint32_t previous = 0;
+        for (size_t i = 0; i <= getTileCount(); i++) {
+            uint32_t offset = readU32(offsets + i * 4);
+            if (offset < previous || offset > pixel_size) {
+                std::cerr << "Corrupt 565 tile table: " << filename << std::endl;
+                return false;
+            }
+            previous = offset;
+        }
+    } else if (pixel_size < static_cast<size_t>(width) * height * 2) {
+        std::cerr << "Truncated 565 file: " << filename << std::endl;
+        return false;
+    }
+
+    file = std::move(mapped);
+    return true;
+}
+
+void Asset565::close() {
+    file.reset();
+    pixel_data = nullptr;
+    offsets = nullptr;
+    pixel_size = 0;
+}
+
+Rectangle Asset565::tileRect(size_t index) const {
+    int16_t x = (index % tiles_x) * tile_width;
+    int16_t y = (index / tiles_x) * tile_height;
+    return Rectangle(x, y, std::min<int>(tile_width, width - x), std::min<int>(tile_height, height - y));
+}
+
+Asset565::Tile Asset565::getTile(size_t index) const {
+    Tile tile;
+    if (!file || index >= getTileCount()) return tile;
+
+    tile.rect = tileRect(index);
+    if (isRLE()) {
+        uint32_t begin = readU32(offsets + index * 4);
+        uint32_t end = readU32(offsets + (index + 1) * 4);
+        tile.data = pixel_data + begin;
+        tile.length = end - begin;
+    } else {
+        // полосы плиток выше целиком, в своей полосе - плитки левее
+        size_t offset = static_cast<size_t>(tile.rect.y) * width +
+                        static_cast<size_t>(tile.rect.x) * tile.rect.height;
+        tile.data = pixel_data + offset * 2;
+        tile.length = static_cast<size_t>(tile.rect.width) * tile.rect.height * 2;
+    }
+    return tile;
+}
+
+bool Asset565::decodeTile(size_t index, uint16_t* pixels) const {
+    Tile tile = getTile(index);
+    if (!tile.data) return false;
+
+    bool big_endian = isBigEndian();
+    size_t count = static_cast<size_t>(tile.rect.width) * tile.rect.height;
+    if (!isRLE()) {
+        for (size_t i = 0; i < count; i++) {
+            pixels[i] = getPixel(tile.data + i * 2, big_endian);
+        }
+        return true;
+    }
+
+    const uint8_t* p = tile.data;
+    const uint8_t* end = tile.data + tile.length;
+    size_t filled = 0;
+    while (filled < count) {
+        if (end - p < 2) return false;
+        uint16_t header = readU16(p);
+        p += 2;
+        size_t n = (header & (RLE_RUN - 1)) + 1;
+        if (n > count - filled) return false;
+
+        if (header & RLE_RUN) {
+            if (end - p < 2) return false;
+            std::fill_n(pixels + filled, n, getPixel(p, big_endian));
+            p += 2;
+        } else {
+            if (static_cast<size_t>(end - p) < n * 2) return false;
+            for (size_t i = 0; i < n; i++, p += 2) {
+                pixels[filled + i] = getPixel(p, big_endian);
+            }
+        }
+        filled += n;
+    }
+    return true;
+}
+
+bool saveAsset565(const std::string& filename, const ImageData& image, const Asset565Options& options) {
+    if (image.width == 0 || image.height == 0 ||
+        image.pixels.size() < static_cast<size_t>(image.width) * image.height) {
+        std::cerr << "Nothing to save to " << filename << std::endl;
+        return false;
+    }
+
+    uint16_t tile_width = options.tile_width ? std::min(options.tile_width, image.width) : image.width;
+    uint16_t tile_height = options.tile_height ? std::min(options.tile_height, image.height) : image.height;
+    size_t tiles_x = (image.width + tile_width - 1) / tile_width;
+    size_t tiles_y = (image.height + tile_height - 1) / tile_height;
+
+    std::vector<uint8_t> out;
+    out.insert(out.end(), {'R', '5', '6', '5', VERSION});
+    out.push_back((options.big_endian ? ASSET565_BIG_ENDIAN : 0) | (options.rle ? ASSET565_RLE : 0));
+    putU16(out, image.width);
+    putU16(out, image.height);
+    putU16(out, options.tile_width ? tile_width : 0);
+    putU16(out, options.tile_height ? tile_height : 0);
+    putU16(out, 0);
+
+    std::vector<uint8_t> body;
+    std::vector<uint32_t> offsets;
+    std::vector<uint16_t> tile;
+    for (size_t ty = 0; ty < tiles_y; ty++) {
+        for (size_t tx = 0; tx < tiles_x; tx++) {
+            size_t x0 = tx * tile_width;
+            size_t y0 = ty * tile_height;
+            size_t w = std::min<size_t>(tile_width, image.width - x0);
+            size_t h = std::min<size_t>(tile_height, image.height - y0);
+
+            tile.clear();
+            for (size_t y = y0; y < y0 + h; y++) {
+                const uint16_t* row = &image.pixels[y * image.width + x0];
+                tile.insert(tile.end(), row, row + w);
+            }
+
+            offsets.push_back(body.size());
+            if (options.rle) {
+                encodeRLE(tile, options.big_endian, body);
+            } else {
+                for (uint16_t pixel : tile) {
+                    putPixel(body, pixel, options.big_endian);
+                }
+            }
+        }
+    }
+    offsets.push_back(body.size());
+
+    if (options.rle) {
+        for (uint32_t offset : offsets) {
+            putU32(out, offset);
+        }
+    }
+    out.insert(out.end(), body.begin(), body.end());
+
+    std::ofstream stream(filename, std::ios::binary | std::ios::trunc);
+    if (!stream.write(reinterpret_cast<const char*>(out.data()), out.size())) {
+        std::cerr << "Failed to write 565 file: " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool loadAsset565(const std::string& filename, ImageData& image) {
+    Asset565 asset;
+    if (!asset.open(filename)) {
+        return false;
+    }
+
+    image.width = asset.getWidth();
+    image.height = asset.getHeight();
+    image.pixels.resize(static_cast<size_t>(image.width) * image.height);
+
+    std::vector<uint16_t> tile_pixels;
+    for (size_t i = 0; i < asset.getTileCount(); i++) {
+        Asset565::Tile tile = asset.getTile(i);
+        tile_pixels.resize(static_cast<size_t>(tile.rect.width) * tile.rect.height);
+        if (!asset.decodeTile(i, tile_pixels.data())) {
+            std::cerr << "Corrupt 565 tile data: " << filename << std::endl;
+            return false;
+        }
+        for (int16_t row = 0; row < tile.rect.height; row++) {
+            std::memcpy(&image.pixels[(tile.rect.y + row) * image.width + tile.rect.x],
+                        &tile_pixels[row * tile.rect.width],
+                        tile.rect.width * sizeof(uint16_t));
+        }
+    }
+    return true;
+}
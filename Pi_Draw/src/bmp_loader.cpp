@@ -0,0 +1,125 @@
+#include "bmp_loader.h"
+#include "mapped_file.h"
+#include "pixel_convert.h"
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr size_t FILE_HEADER_SIZE = 14;
+constexpr size_t INFO_HEADER_SIZE = 40;
+constexpr uint32_t BI_RGB = 0;
+constexpr uint32_t BI_BITFIELDS = 3;
+
+uint16_t readU16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+uint32_t readU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+} // namespace
+
+bool loadBMP(const std::string& filename, ImageData& image, DitherMode dither) {
+    MappedFile file(filename);
+    if (!file.data) {
+        std::cerr << "Failed to open BMP file: " << filename << std::endl;
+        return false;
+    }
+
+    const uint8_t* data = file.data;
+    if (file.size < FILE_HEADER_SIZE + INFO_HEADER_SIZE || data[0] != 'B' || data[1] != 'M') {
+        std::cerr << "Not a BMP file: " << filename << std::endl;
+        return false;
+    }
+
+    uint32_t pixel_offset = readU32(data + 10);
+    uint32_t header_size = readU32(data + 14);
+    int32_t width = static_cast<int32_t>(readU32(data + 18));
+    int32_t height = static_cast<int32_t>(readU32(data + 22));
+    uint16_t bits = readU16(data + 28);
+    uint32_t compression = readU32(data + 30);
+    uint32_t colors_used = readU32(data + 46);
+
+    // отрицательная высота - строки идут сверху вниз
+    bool top_down = height < 0;
+    if (top_down) height = -height;
+
+    if (header_size < INFO_HEADER_SIZE || width <= 0 || height <= 0 ||
+        width > UINT16_MAX || height > UINT16_MAX) {
+        std::cerr << "Unsupported BMP header" << std::endl;
+        return false;
+    }
+
+    bool supported = (compression == BI_RGB && (bits == 8 || bits == 24 || bits == 32)) ||
+                     (compression == BI_BITFIELDS && bits == 32);
+    if (compression == BI_BITFIELDS) {
+        // маски лежат после заголовка; принимаем только обычный порядок BGRX
+        size_t masks = FILE_HEADER_SIZE + INFO_HEADER_SIZE;
+        supported = supported && masks + 12 <= file.size &&
+                    readU32(data + masks) == 0x00FF0000 &&
+                    readU32(data + masks + 4) == 0x0000FF00 &&
+                    readU32(data + masks + 8) == 0x000000FF;
+    }
+    if (!supported) {
+        std::cerr << "Unsupported BMP format: " << bits << " bpp, compression " << compression << std::endl;
+        return false;
+    }
+
+    // строки выровнены на 4 байта
+    size_t stride = ((static_cast<size_t>(width) * bits + 31) / 32) * 4;
+    if (pixel_offset > file.size || stride * height > file.size - pixel_offset) {
+        std::cerr << "Truncated BMP file: " << filename << std::endl;
+        return false;
+    }
+
+    uint16_t palette[256] = {};
+    uint8_t palette_bgr[256 * 3] = {};
+    if (bits == 8) {
+        size_t count = colors_used == 0 || colors_used > 256 ? 256 : colors_used;
+        size_t palette_offset = FILE_HEADER_SIZE + header_size;
+        if (palette_offset + count * 4 > pixel_offset) {
+            count = pixel_offset > palette_offset ? (pixel_offset - palette_offset) / 4 : 0;
+        }
+        for (size_t i = 0; i < count; i++) {
+            const uint8_t* entry = data + palette_offset + i * 4;
+            palette[i] = pixel_convert::rgb565(entry[2], entry[1], entry[0]);
+            std::memcpy(&palette_bgr[i * 3], entry, 3);
+        }
+    }
+
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(static_cast<size_t>(width) * height);
+
+    Ditherer ditherer(dither);
+    ditherer.begin(width);
+
+    for (int32_t y = 0; y < height; y++) {
+        const uint8_t* src = data + pixel_offset + stride * (top_down ? y : height - 1 - y);
+        uint16_t* dst = &image.pixels[static_cast<size_t>(y) * width];
+        if (dither != DitherMode::None) {
+            if (bits == 8) {
+                ditherer.indexedRow(src, palette_bgr, dst, y);
+            } else if (bits == 24) {
+                ditherer.bgr24Row(src, dst, y);
+            } else {
+                ditherer.bgrx32Row(src, dst, y);
+            }
+            continue;
+        }
+        switch (bits) {
+            case 8:
+                pixel_convert::indexedToRGB565(src, palette, dst, width);
+                break;
+            case 24:
+                pixel_convert::bgr24ToRGB565(src, dst, width);
+                break;
+            case 32:
+                pixel_convert::bgrx32ToRGB565(src, dst, width);
+                break;
+        }
+    }
+    return true;
+}
@@ -1,33 +1,172 @@
 #include "canvas.h"
+#include "trace.h"
+#include <algorithm>
 #include <cmath>
 
 Canvas::Canvas(const sf::Vector2f& position, const sf::Vector2f& size, TFTDisplay& display)
-    : tftDisplay(display), canvasPosition(position), canvasSize(size) {
+    : tftDisplay(display), canvasPosition(position), canvasSize(size),
+      strokePending(false), zoom(1), panning(false) {
     canvas.setPosition(position);
     canvas.setSize(size);
-    canvas.setFillColor(sf::Color::White);
+    canvas.setFillColor(sf::Color(200, 200, 200));
     canvas.setOutlineColor(sf::Color::Black);
     canvas.setOutlineThickness(1.0f);
+    preview.setSmooth(false);
+    resetView();
 }
 
 void Canvas::draw(sf::RenderWindow& window) {
+    updatePreview();
     window.draw(canvas);
+
+    // clip the zoomed preview to the canvas area
+    sf::Vector2u windowSize = window.getSize();
+    sf::View view(sf::FloatRect(canvasPosition.x, canvasPosition.y, canvasSize.x, canvasSize.y));
+    view.setViewport(sf::FloatRect(canvasPosition.x / windowSize.x, canvasPosition.y / windowSize.y,
+                                   canvasSize.x / windowSize.x, canvasSize.y / windowSize.y));
+    sf::View previous = window.getView();
+    window.setView(view);
+
+    previewSprite.setPosition(canvasPosition + pan);
+    previewSprite.setScale(static_cast<float>(zoom), static_cast<float>(zoom));
+    window.draw(previewSprite);
+
+    window.setView(previous);
+}
+
+void Canvas::resetView() {
+    int width = tftDisplay.getWidth();
+    int height = tftDisplay.getHeight();
+    zoom = std::max(1, static_cast<int>(std::min(canvasSize.x / width, canvasSize.y / height)));
+    pan = sf::Vector2f(std::floor((canvasSize.x - width * zoom) / 2),
+                       std::floor((canvasSize.y - height * zoom) / 2));
+}
+
+void Canvas::zoomAt(const sf::Vector2f& windowPos, int newZoom) {
+    newZoom = std::max(1, std::min(MAX_ZOOM, newZoom));
+    if (newZoom == zoom) return;
+
+    // keep the panel pixel under the cursor in place
+    sf::Vector2f local = windowPos - canvasPosition;
+    sf::Vector2f pixel = (local - pan) / static_cast<float>(zoom);
+    pan = local - pixel * static_cast<float>(newZoom);
+    pan = sf::Vector2f(std::floor(pan.x), std::floor(pan.y));
+    zoom = newZoom;
+}
+
+void Canvas::updatePreview() {
+    unsigned int width = tftDisplay.getWidth();
+    unsigned int height = tftDisplay.getHeight();
+
+    // first frame or rotation changed the panel size: upload everything
+    sf::Vector2u size = preview.getSize();
+    if (size.x != width || size.y != height) {
+        if (!preview.create(width, height)) {
+            return;
+        }
+        previewSprite.setTexture(preview, true);
+        resetView();
+        tftDisplay.takePresentedRects(updatedRects);
+        uploadRect(Rectangle(0, 0, width, height));
+        return;
+    }
+
+    if (!tftDisplay.takePresentedRects(updatedRects)) {
+        return;
+    }
+    for (const Rectangle& rect : updatedRects) {
+        uploadRect(rect);
+    }
+}
+
+void Canvas::uploadRect(const Rectangle& rect) {
+    int x0 = std::max<int>(rect.x, 0);
+    int y0 = std::max<int>(rect.y, 0);
+    int x1 = std::min<int>(rect.x + rect.width, tftDisplay.getWidth());
+    int y1 = std::min<int>(rect.y + rect.height, tftDisplay.getHeight());
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    // RGB565 -> RGBA8888, low bits are filled from the high ones
+    const uint16_t* pixels = tftDisplay.getPixels();
+    int stride = tftDisplay.getWidth();
+    uploadBuffer.resize(static_cast<size_t>(x1 - x0) * (y1 - y0) * 4);
+    sf::Uint8* out = uploadBuffer.data();
+    for (int y = y0; y < y1; y++) {
+        const uint16_t* row = pixels + y * stride;
+        for (int x = x0; x < x1; x++) {
+            uint16_t c = row[x];
+            uint8_t r = (c >> 11) & 0x1F;
+            uint8_t g = (c >> 5) & 0x3F;
+            uint8_t b = c & 0x1F;
+            *out++ = (r << 3) | (r >> 2);
+            *out++ = (g << 2) | (g >> 4);
+            *out++ = (b << 3) | (b >> 2);
+            *out++ = 255;
+        }
+    }
+    preview.update(uploadBuffer.data(), x1 - x0, y1 - y0, x0, y0);
 }
 
 void Canvas::handleEvent(const sf::Event& event, DrawingProperties& props) {
-    if (!isInsideCanvas(sf::Vector2f(event.mouseButton.x, event.mouseButton.y))) {
+    sf::Vector2f position;
+    switch (event.type) {
+        case sf::Event::MouseButtonPressed:
+        case sf::Event::MouseButtonReleased:
+            position = sf::Vector2f(event.mouseButton.x, event.mouseButton.y);
+            break;
+        case sf::Event::MouseMoved:
+            position = sf::Vector2f(event.mouseMove.x, event.mouseMove.y);
+            break;
+        case sf::Event::MouseWheelScrolled:
+            position = sf::Vector2f(event.mouseWheelScroll.x, event.mouseWheelScroll.y);
+            break;
+        default:
+            return;
+    }
+
+    // view navigation: wheel zooms around the cursor, right drag pans,
+    // middle click fits the panel back into the canvas
+    if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Right) {
+        panning = false;
+    }
+    if (event.type == sf::Event::MouseMoved && panning) {
+        pan = position - panAnchor;
+    }
+
+    if (!isInsideCanvas(position)) {
         return;
     }
 
     switch (event.type) {
+        case sf::Event::MouseWheelScrolled:
+            if (event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel) {
+                zoomAt(position, zoom + (event.mouseWheelScroll.delta > 0 ? 1 : -1));
+            }
+            break;
+
         case sf::Event::MouseButtonPressed:
-            if (event.mouseButton.button == sf::Mouse::Left) {
+            if (event.mouseButton.button == sf::Mouse::Right) {
+                panning = true;
+                panAnchor = position - pan;
+            } else if (event.mouseButton.button == sf::Mouse::Middle) {
+                resetView();
+            } else if (event.mouseButton.button == sf::Mouse::Left) {
+                if (isFill(props.currentTool)) {
+                    // fills act on the click, there is nothing to drag
+                    fillAt(windowToCanvas(position), props);
+                    break;
+                }
                 props.isDrawing = true;
-                props.startPoint = windowToCanvas(sf::Vector2f(event.mouseButton.x, event.mouseButton.y));
+                props.startPoint = windowToCanvas(position);
                 props.endPoint = props.startPoint;
                 
-                if (props.currentTool == Tool::Pencil || props.currentTool == Tool::Eraser) {
-                    drawToDisplay(props);
+                if (isFreehand(props.currentTool)) {
+                    // the dot under the cursor goes out with the rest of the frame
+                    strokePoints.assign(1, props.startPoint);
+                    strokePending = true;
+                    TRACE_EVENT_RANGE_ADD(strokeEvents);
                 }
             }
             break;
@@ -35,17 +174,25 @@ void Canvas::handleEvent(const sf::Event& event, DrawingProperties& props) {
         case sf::Event::MouseButtonReleased:
             if (event.mouseButton.button == sf::Mouse::Left && props.isDrawing) {
                 props.isDrawing = false;
-                props.endPoint = windowToCanvas(sf::Vector2f(event.mouseButton.x, event.mouseButton.y));
-                drawToDisplay(props);
+                props.endPoint = windowToCanvas(position);
+                if (isFreehand(props.currentTool)) {
+                    addStrokePoint(props.endPoint);
+                    TRACE_EVENT_RANGE_ADD(strokeEvents);
+                    commitStroke(props);
+                    strokePoints.clear();
+                } else {
+                    drawToDisplay(props);
+                }
             }
             break;
 
         case sf::Event::MouseMoved:
             if (props.isDrawing) {
-                props.endPoint = windowToCanvas(sf::Vector2f(event.mouseMove.x, event.mouseMove.y));
+                props.endPoint = windowToCanvas(position);
                 
-                if (props.currentTool == Tool::Pencil || props.currentTool == Tool::Eraser) {
-                    drawToDisplay(props);
+                if (isFreehand(props.currentTool)) {
+                    addStrokePoint(props.endPoint);
+                    TRACE_EVENT_RANGE_ADD(strokeEvents);
                     props.startPoint = props.endPoint;
                 }
             }
@@ -56,12 +203,51 @@ void Canvas::handleEvent(const sf::Event& event, DrawingProperties& props) {
     }
 }
 
+void Canvas::commitInput(const DrawingProperties& props) {
+    commitStroke(props);
+}
+
+bool Canvas::isFreehand(Tool tool) {
+    return tool == Tool::Pencil || tool == Tool::Eraser;
+}
+
+bool Canvas::isFill(Tool tool) {
+    return tool == Tool::Fill || tool == Tool::Background;
+}
+
+void Canvas::addStrokePoint(const Point& point) {
+    if (strokePoints.empty()) return;
+    const Point& last = strokePoints.back();
+    if (point.x != last.x || point.y != last.y) {
+        strokePoints.push_back(point);
+        strokePending = true;
+    }
+}
+
+void Canvas::commitStroke(const DrawingProperties& props) {
+    if (!strokePending || strokePoints.empty()) return;
+    TRACE_SCOPE("Canvas::commitStroke");
+    // the flush counts from the oldest motion event folded into the batch
+    TRACE_EVENT_RANGE_TAG(strokeEvents);
+
+    uint16_t color = props.currentTool == Tool::Eraser ? props.backgroundColor : props.color;
+    spans.clear();
+    raster::strokePolyline(strokePoints, props.lineWidth, LineCap::Round, spans);
+    tftDisplay.fillSpans(spans, color);
+    tftDisplay.present();
+
+    strokePoints.erase(strokePoints.begin(), strokePoints.end() - 1);
+    strokePending = false;
+    strokeEvents.clear();
+}
+
 void Canvas::drawToDisplay(const DrawingProperties& props) {
-    uint16_t color = props.currentTool == Tool::Eraser ? COLOR_WHITE : props.color;
+    TRACE_SCOPE("Canvas::drawToDisplay");
+    uint16_t color = props.currentTool == Tool::Eraser ? props.backgroundColor : props.color;
 
     switch (props.currentTool) {
         case Tool::Line:
-            drawLine(props.startPoint, props.endPoint, color, props.lineWidth);
+            drawLine(props.startPoint, props.endPoint, color, props.lineWidth, LineCap::Butt);
             break;
 
         case Tool::Rectangle:
@@ -77,114 +263,100 @@ void Canvas::drawToDisplay(const DrawingProperties& props) {
             break;
         }
 
+        case Tool::Ellipse:
+            drawEllipse(props.startPoint, props.endPoint, color, props.lineWidth, props.filled);
+            break;
+
         case Tool::Pencil:
         case Tool::Eraser:
-            drawLine(props.startPoint, props.endPoint, color, props.lineWidth);
+            drawLine(props.startPoint, props.endPoint, color, props.lineWidth, LineCap::Round);
+            break;
+
+        default:
             break;
     }
+
+    tftDisplay.present();
 }
 
-void Canvas::drawLine(const Point& start, const Point& end, uint16_t color, uint8_t width) {
-    int16_t dx = end.x - start.x;
-    int16_t dy = end.y - start.y;
-    int16_t steps = std::max(std::abs(dx), std::abs(dy));
+void Canvas::fillAt(const Point& point, DrawingProperties& props) {
+    TRACE_SCOPE("Canvas::fillAt");
+    const uint16_t* pixels = tftDisplay.getPixels();
+    int width = tftDisplay.getWidth();
+    int height = tftDisplay.getHeight();
 
-    float xIncrement = static_cast<float>(dx) / steps;
-    float yIncrement = static_cast<float>(dy) / steps;
+    // the fill reads the framebuffer and only then writes the result as row
+    // runs, so the panel gets one dirty rectangle instead of per-pixel writes
+    spans.clear();
+    if (props.currentTool == Tool::Background) {
+        FloodFill::replace(pixels, width, height, props.backgroundColor, props.fillTolerance, spans);
+        // the eraser paints with the new background from now on
+        props.backgroundColor = props.color;
+    } else {
+        floodFill.fill(pixels, width, height, point.x, point.y,
+                       props.fillTolerance, props.fillConnectivity, spans);
+    }
+    if (spans.empty()) {
+        return;
+    }
 
-    float x = start.x;
-    float y = start.y;
+    tftDisplay.fillSpans(spans, props.color);
+    tftDisplay.present();
+}
 
-    for (int16_t i = 0; i <= steps; i++) {
-        for (int8_t w = 0; w < width; w++) {
-            for (int8_t h = 0; h < width; h++) {
-                tftDisplay.drawPixel(static_cast<int16_t>(x) + w, 
-                                   static_cast<int16_t>(y) + h, 
-                                   color);
-            }
-        }
-        x += xIncrement;
-        y += yIncrement;
-    }
+void Canvas::drawLine(const Point& start, const Point& end, uint16_t color, uint8_t width, LineCap cap) {
+    spans.clear();
+    raster::strokeLine(start.x, start.y, end.x, end.y, width, cap, spans);
+    tftDisplay.fillSpans(spans, color);
 }
 
 void Canvas::drawRectangle(const Point& start, const Point& end, uint16_t color, uint8_t width, bool filled) {
-    int16_t x1 = std::min(start.x, end.x);
-    int16_t y1 = std::min(start.y, end.y);
-    int16_t x2 = std::max(start.x, end.x);
-    int16_t y2 = std::max(start.y, end.y);
-
+    spans.clear();
     if (filled) {
-        for (int16_t y = y1; y <= y2; y++) {
-            for (int16_t x = x1; x <= x2; x++) {
-                tftDisplay.drawPixel(x, y, color);
-            }
-        }
+        raster::fillRect(start.x, start.y, end.x, end.y, spans);
     } else {
-        // Draw horizontal lines
-        for (int16_t x = x1; x <= x2; x++) {
-            for (int8_t w = 0; w < width; w++) {
-                tftDisplay.drawPixel(x, y1 + w, color);
-                tftDisplay.drawPixel(x, y2 - w, color);
-            }
-        }
-        // Draw vertical lines
-        for (int16_t y = y1; y <= y2; y++) {
-            for (int8_t w = 0; w < width; w++) {
-                tftDisplay.drawPixel(x1 + w, y, color);
-                tftDisplay.drawPixel(x2 - w, y, color);
-            }
-        }
+        raster::strokeRect(start.x, start.y, end.x, end.y, width, spans);
     }
+    tftDisplay.fillSpans(spans, color);
 }
 
 void Canvas::drawCircle(const Point& center, uint16_t radius, uint16_t color, uint8_t width, bool filled) {
+    spans.clear();
     if (filled) {
-        for (int16_t y = -radius; y <= radius; y++) {
-            for (int16_t x = -radius; x <= radius; x++) {
-                if (x*x + y*y <= radius*radius) {
-                    tftDisplay.drawPixel(center.x + x, center.y + y, color);
-                }
-            }
-        }
+        raster::fillCircle(center.x, center.y, radius, spans);
     } else {
-        int16_t x = radius - 1;
-        int16_t y = 0;
-        int16_t dx = 1;
-        int16_t dy = 1;
-        int16_t err = dx - (radius << 1);
-
-        while (x >= y) {
-            for (int8_t w = 0; w < width; w++) {
-                tftDisplay.drawPixel(center.x + x + w, center.y + y, color);
-                tftDisplay.drawPixel(center.x + y + w, center.y + x, color);
-                tftDisplay.drawPixel(center.x - y + w, center.y + x, color);
-                tftDisplay.drawPixel(center.x - x + w, center.y + y, color);
-                tftDisplay.drawPixel(center.x - x + w, center.y - y, color);
-                tftDisplay.drawPixel(center.x - y + w, center.y - x, color);
-                tftDisplay.drawPixel(center.x + y + w, center.y - x, color);
-                tftDisplay.drawPixel(center.x + x + w, center.y - y, color);
-            }
+        raster::circleRing(center.x, center.y, radius, width, spans);
+    }
+    tftDisplay.fillSpans(spans, color);
+}
 
-            if (err <= 0) {
-                y++;
-                err += dy;
-                dy += 2;
-            }
-            if (err > 0) {
-                x--;
-                dx += 2;
-                err += dx - (radius << 1);
-            }
-        }
+void Canvas::drawEllipse(const Point& start, const Point& end, uint16_t color, uint8_t width, bool filled) {
+    int16_t x1 = std::min(start.x, end.x);
+    int16_t y1 = std::min(start.y, end.y);
+    int16_t x2 = std::max(start.x, end.x);
+    int16_t y2 = std::max(start.y, end.y);
+
+    // ellipse inscribed in the dragged box
+    int16_t cx = (x1 + x2) / 2;
+    int16_t cy = (y1 + y2) / 2;
+    int16_t rx = (x2 - x1) / 2;
+    int16_t ry = (y2 - y1) / 2;
+
+    spans.clear();
+    if (filled) {
+        raster::fillEllipse(cx, cy, rx, ry, spans);
+    } else {
+        raster::ellipseRing(cx, cy, rx, ry, width, spans);
     }
+    tftDisplay.fillSpans(spans, color);
 }
 
 Point Canvas::windowToCanvas(const sf::Vector2f& windowPos) const {
-    sf::Vector2f relativePos = windowPos - canvasPosition;
+    // inverse of the preview transform, so input lands on the pixel shown under the cursor
+    sf::Vector2f relativePos = windowPos - canvasPosition - pan;
     return Point{
-        static_cast<int16_t>(relativePos.x),
-        static_cast<int16_t>(relativePos.y)
+        static_cast<int16_t>(std::floor(relativePos.x / zoom)),
+        static_cast<int16_t>(std::floor(relativePos.y / zoom))
     };
 }
 
@@ -193,9 +365,6 @@ bool Canvas::isInsideCanvas(const sf::Vector2f& point) const {
 }
 
 void Canvas::clear() {
-    for (int16_t y = 0; y < canvasSize.y; y++) {
-        for (int16_t x = 0; x < canvasSize.x; x++) {
-            tftDisplay.drawPixel(x, y, COLOR_WHITE);
-        }
-    }
+    tftDisplay.clearScreen(COLOR_WHITE);
+    tftDisplay.present();
 } 
\ No newline at end of file
@@ -1,15 +1,91 @@
 #include "display_pi.h"
+#include "asset565.h"
 #include <stdexcept>
-#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
 #include <thread>
 
-TFTDisplay::TFTDisplay(int channel, int reset_pin, int dc_pin, int width, int height)
-    : spi(channel), reset_pin(reset_pin), dc_pin(dc_pin),
-      width(width), height(height), rotation(DisplayRotation::PORTRAIT),
-      current_color(0xFFFF), current_font(Font::DEFAULT) {
+namespace {
+
+// касаются ли прямоугольники друг друга (пересечение или общая граница)
+bool touches(const Rectangle& a, const Rectangle& b) {
+    return a.x <= b.x + b.width && b.x <= a.x + a.width &&
+           a.y <= b.y + b.height && b.y <= a.y + a.height;
+}
+
+Rectangle unite(const Rectangle& a, const Rectangle& b) {
+    int16_t x0 = std::min(a.x, b.x);
+    int16_t y0 = std::min(a.y, b.y);
+    int16_t x1 = std::max(a.x + a.width, b.x + b.width);
+    int16_t y1 = std::max(a.y + a.height, b.y + b.height);
+    return Rectangle(x0, y0, x1 - x0, y1 - y0);
+}
+
+int32_t area(const Rectangle& r) {
+    return static_cast<int32_t>(r.width) * r.height;
+}
+
+void addDirtyRect(std::vector<Rectangle>& rects, Rectangle rect, size_t max_rects) {
+    // сливаем с соседними областями, пока есть с чем сливать
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (auto it = rects.begin(); it != rects.end(); ++it) {
+            if (touches(*it, rect)) {
+                rect = unite(*it, rect);
+                rects.erase(it);
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    if (rects.size() < max_rects) {
+        rects.push_back(rect);
+        return;
+    }
+
+    // список заполнен: объединяем с областью, дающей наименьший прирост площади
+    auto best = rects.begin();
+    int32_t best_cost = INT32_MAX;
+    for (auto it = rects.begin(); it != rects.end(); ++it) {
+        int32_t cost = area(unite(*it, rect)) - area(*it) - area(rect);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best = it;
+        }
+    }
+    *best = unite(*best, rect);
+}
+
+} // namespace
+
+TFTDisplay::TFTDisplay(std::unique_ptr<SPIBackend> backend, int width, int height,
+                       FlushMode flush_mode, PixelFormat pixel_format)
+    : spi(std::move(backend)),
+      width(width), height(height), panel_width(width), panel_height(height),
+      rotation(DisplayRotation::ROTATION_0),
+      current_color(0xFFFF), current_font(FONT_5X7),
+      framebuffer(width * height, 0), pixel_format(&getPixelFormatInfo(pixel_format)),
+      shadow(width * height, 0), shadow_valid(false), diff_flush(true),
+      window_columns(-1), window_rows(-1),
+      scroll_top(0), scroll_height(0), scroll_offset(0), scroll_hardware(false),
+      flush_mode(flush_mode), pending_frame(-1), active_frame(-1), flush_running(false),
+      perf(nullptr) {
+    dirty_rects.reserve(MAX_DIRTY_RECTS);
+    presented_rects.reserve(MAX_DIRTY_RECTS);
 }
 
 TFTDisplay::~TFTDisplay() {
+    if (flush_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(flush_mutex);
+            flush_running = false;
+        }
+        flush_cv.notify_one();
+        flush_thread.join();
+    }
 }
 
 bool TFTDisplay::init() {
@@ -19,112 +95,235 @@ bool TFTDisplay::init() {
 
     // сброс
     spi.setRST(false);
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    spi.delay(10);
     spi.setRST(true);
-    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    spi.delay(120);
 
     // инициализация дисплея
     writeCommand(0x01); // сброс
-    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    spi.delay(150);
 
     writeCommand(0x11); // выход из сна
-    std::this_thread::sleep_for(std::chrono::milliseconds(255));
+    spi.delay(255);
 
-    writeCommand(0x3A); // формат пикселей
-    uint8_t data = 0x05; // 16-bit color
-    writeData(&data, 1);
+    uint8_t data = pixel_format->colmod;
+    writeCommand(0x3A, &data, 1); // формат пикселей
 
-    writeCommand(0x36); // управление доступом к данным
     data = 0x00; // нормальный режим
-    writeData(&data, 1);
+    writeCommand(0x36, &data, 1); // управление доступом к данным
 
+    window_columns = window_rows = -1;
     writeCommand(0x29); // включение дисплея
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    spi.delay(100);
+
+    // память панели после сброса случайна: первый present() выгружает весь
+    // кадровый буфер, после этого теневая копия известна
+    shadow_valid = false;
+    markDirty(0, 0, width, height);
+
+    // дальше шиной владеет поток отправки
+    if (flush_mode == FlushMode::Async && !flush_thread.joinable()) {
+        flush_running = true;
+        flush_thread = std::thread(&TFTDisplay::flushLoop, this);
+    }
 
     return true;
 }
 
 void TFTDisplay::setRotation(DisplayRotation rotation) {
+    // команда не должна вклиниться между окном адресов и пикселями кадра
+    present();
+    waitIdle();
     this->rotation = rotation;
-    writeCommand(0x36); // управление доступом к данным
     
     uint8_t data = 0;
     switch (rotation) {
-        case DisplayRotation::PORTRAIT:
+        case DisplayRotation::ROTATION_0:
             data = 0x00;
             break;
-        case DisplayRotation::LANDSCAPE:
+        case DisplayRotation::ROTATION_90:
             data = 0x60;
             break;
-        case DisplayRotation::PORTRAIT_INVERTED:
+        case DisplayRotation::ROTATION_180:
             data = 0xC0;
             break;
-        case DisplayRotation::LANDSCAPE_INVERTED:
+        case DisplayRotation::ROTATION_270:
             data = 0xA0;
             break;
     }
-    writeData(&data, 1);
+    writeCommand(0x36, &data, 1); // управление доступом к данным
+    window_columns = window_rows = -1;
+
+    // прокрутка идёт по строкам матрицы: после поворота она аппаратная
+    // только в исходной ориентации, буфер ниже всё равно выводится целиком
+    if (scroll_hardware) {
+        writeScrollArea(0, GRAM_LINES);
+        writeScrollStart(0);
+        scroll_hardware = false;
+    }
+    scroll_offset = 0;
+
+    // в альбомной ориентации ширина и высота меняются местами,
+    // буфер того же размера просто переинтерпретируется
+    bool landscape = rotation == DisplayRotation::ROTATION_90 ||
+                     rotation == DisplayRotation::ROTATION_270;
+    width = landscape ? panel_height : panel_width;
+    height = landscape ? panel_width : panel_height;
+    shadow_valid = false;
+    dirty_rects.clear();
+    presented_rects.clear();
+    markDirty(0, 0, width, height);
+
+    if (scroll_height > 0) {
+        if (scroll_top + scroll_height > height) {
+            scroll_height = 0;
+        } else if (rotation == DisplayRotation::ROTATION_0) {
+            writeScrollArea(scroll_top, scroll_height);
+            writeScrollStart(scroll_top);
+            scroll_hardware = true;
+        }
+    }
 }
 
-void TFTDisplay::clearScreen(uint16_t color) {
-    fillRect(0, 0, width, height, color);
-}
+bool TFTDisplay::setScrollArea(int16_t top, int16_t height) {
+    clearScrollArea();
+    if (top < 0 || height <= 0 || top + height > this->height) return false;
 
-void TFTDisplay::drawPixel(int16_t x, int16_t y, uint16_t color) {
-    if (x < 0 || x >= width || y < 0 || y >= height) return;
-    
-    setAddressWindow(x, y, x, y);
-    writeData(reinterpret_cast<uint8_t*>(&color), 2);
+    scroll_top = top;
+    scroll_height = height;
+    if (rotation != DisplayRotation::ROTATION_0) return false;
+
+    writeScrollArea(top, height);
+    writeScrollStart(top);
+    scroll_hardware = true;
+    return true;
 }
 
-void TFTDisplay::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
-    int16_t steep = abs(y1 - y0) > abs(x1 - x0);
-    if (steep) {
-        std::swap(x0, y0);
-        std::swap(x1, y1);
+void TFTDisplay::clearScrollArea() {
+    present();
+    waitIdle();
+
+    if (scroll_hardware) {
+        writeScrollArea(0, GRAM_LINES);
+        writeScrollStart(0);
+        // строки полосы лежат в памяти со сдвигом - переписываем их на места;
+        // на экране они теперь в порядке памяти, туда же сдвигается копия
+        if (scroll_offset != 0) {
+            rotateShadowRows(scroll_top, scroll_height, scroll_height - scroll_offset);
+            markDirty(0, scroll_top, width, scroll_height);
+        }
     }
+    scroll_top = scroll_height = scroll_offset = 0;
+    scroll_hardware = false;
+}
 
-    if (x0 > x1) {
-        std::swap(x0, x1);
-        std::swap(y0, y1);
-    }
+void TFTDisplay::scrollUp(int16_t lines, uint16_t fill) {
+    if (scroll_height <= 0 || lines <= 0) return;
+    lines = std::min(lines, scroll_height);
 
-    int16_t dx = x1 - x0;
-    int16_t dy = abs(y1 - y0);
-    int16_t err = dx / 2;
-    int16_t ystep = (y0 < y1) ? 1 : -1;
+    // всё нарисованное до сдвига уходит по старому соответствию строк
+    if (scroll_hardware) {
+        present();
+        waitIdle();
+    }
 
-    for (; x0 <= x1; x0++) {
-        if (steep) {
-            drawPixel(y0, x0, color);
-        } else {
-            drawPixel(x0, y0, color);
+    // освободившиеся снизу строки памяти панели - это уехавшие вверх строки:
+    // переписывать нужно только столбцы, где они отличались от заливки
+    uint16_t* area = &framebuffer[scroll_top * width];
+    int16_t stale_x0 = width;
+    int16_t stale_x1 = 0;
+    for (int16_t row = 0; row < lines; row++) {
+        const uint16_t* line = &area[row * width];
+        for (int16_t x = 0; x < stale_x0; x++) {
+            if (line[x] != fill) {
+                stale_x0 = x;
+                break;
+            }
         }
-        err -= dy;
-        if (err < 0) {
-            y0 += ystep;
-            err += dx;
+        for (int16_t x = width - 1; x >= stale_x1; x--) {
+            if (line[x] != fill) {
+                stale_x1 = x + 1;
+                break;
+            }
         }
     }
+
+    size_t kept = static_cast<size_t>(scroll_height - lines) * width;
+    std::memmove(area, area + static_cast<size_t>(lines) * width, kept * sizeof(uint16_t));
+    std::fill_n(area + kept, static_cast<size_t>(lines) * width, fill);
+
+    if (!scroll_hardware) {
+        markDirty(0, scroll_top, width, scroll_height);
+        return;
+    }
+
+    // на панель уходят адрес начала полосы и изменённая часть новых строк;
+    // зеркалам и превью сдвинутая полоса нужна целиком
+    scroll_offset = (scroll_offset + lines) % scroll_height;
+    writeScrollStart(scroll_top + scroll_offset);
+    rotateShadowRows(scroll_top, scroll_height, lines);
+    addDirtyRect(presented_rects, Rectangle(0, scroll_top, width, scroll_height), MAX_DIRTY_RECTS);
+    if (stale_x0 < stale_x1) {
+        markDirty(stale_x0, scroll_top + scroll_height - lines, stale_x1 - stale_x0, lines);
+    }
+}
+
+void TFTDisplay::writeScrollArea(int16_t top, int16_t height) {
+    int16_t bottom = GRAM_LINES - top - height;
+    uint8_t data[6] = {
+        static_cast<uint8_t>(top >> 8),
+        static_cast<uint8_t>(top & 0xFF),
+        static_cast<uint8_t>(height >> 8),
+        static_cast<uint8_t>(height & 0xFF),
+        static_cast<uint8_t>(bottom >> 8),
+        static_cast<uint8_t>(bottom & 0xFF)
+    };
+    writeCommand(CMD_VSCRDEF, data, 6);
+}
+
+void TFTDisplay::writeScrollStart(int16_t line) {
+    uint8_t data[2] = {
+        static_cast<uint8_t>(line >> 8),
+        static_cast<uint8_t>(line & 0xFF)
+    };
+    writeCommand(CMD_VSCSAD, data, 2);
+}
+
+void TFTDisplay::clearScreen(uint16_t color) {
+    fillRect(0, 0, width, height, color);
+}
+
+void TFTDisplay::drawPixel(int16_t x, int16_t y, uint16_t color) {
+    if (x < 0 || x >= width || y < 0 || y >= height) return;
+    
+    framebuffer[y * width + x] = color;
+    markDirty(x, y, 1, 1);
+}
+
+void TFTDisplay::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+    span_buffer.clear();
+    raster::strokeLine(x0, y0, x1, y1, 1, LineCap::Butt, span_buffer);
+    fillSpans(span_buffer, color);
 }
 
 void TFTDisplay::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
-    drawLine(x, y, x + w - 1, y, color);
-    drawLine(x, y + h - 1, x + w - 1, y + h - 1, color);
-    drawLine(x, y, x, y + h - 1, color);
-    drawLine(x + w - 1, y, x + w - 1, y + h - 1, color);
+    if (w <= 0 || h <= 0) return;
+    span_buffer.clear();
+    raster::strokeRect(x, y, x + w - 1, y + h - 1, 1, span_buffer);
+    fillSpans(span_buffer, color);
 }
 
 void TFTDisplay::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
-    if (x < 0 || y < 0 || w <= 0 || h <= 0) return;
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
     if (x + w > width) w = width - x;
     if (y + h > height) h = height - y;
+    if (w <= 0 || h <= 0) return;
 
-    setAddressWindow(x, y, x + w - 1, y + h - 1);
-    
-    uint32_t num_pixels = w * h;
-    std::vector<uint16_t> buffer(num_pixels, color);
-    writeData(reinterpret_cast<uint8_t*>(buffer.data()), num_pixels * 2);
+    for (int16_t row = y; row < y + h; row++) {
+        std::fill_n(&framebuffer[row * width + x], w, color);
+    }
+    markDirty(x, y, w, h);
 }
 
 void TFTDisplay::drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
@@ -161,27 +360,36 @@ void TFTDisplay::drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
 }
 
 void TFTDisplay::fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
-    drawLine(x0, y0 - r, x0, y0 - r + 2 * r + 1, color);
-    int16_t f = 1 - r;
-    int16_t ddF_x = 1;
-    int16_t ddF_y = -2 * r;
-    int16_t x = 0;
-    int16_t y = r;
+    span_buffer.clear();
+    raster::fillCircle(x0, y0, r, span_buffer);
+    fillSpans(span_buffer, color);
+}
 
-    while (x < y) {
-        if (f >= 0) {
-            y--;
-            ddF_y += 2;
-            f += ddF_y;
-        }
-        x++;
-        ddF_x += 2;
-        f += ddF_x;
+void TFTDisplay::fillEllipse(int16_t x0, int16_t y0, int16_t rx, int16_t ry, uint16_t color) {
+    span_buffer.clear();
+    raster::fillEllipse(x0, y0, rx, ry, span_buffer);
+    fillSpans(span_buffer, color);
+}
+
+void TFTDisplay::fillSpans(const std::vector<Span>& spans, uint16_t color) {
+    int16_t min_x = width, min_y = height, max_x = -1, max_y = -1;
 
-        drawLine(x0 + x, y0 - y, x0 + x, y0 + y, color);
-        drawLine(x0 - x, y0 - y, x0 - x, y0 + y, color);
-        drawLine(x0 + y, y0 - x, x0 + y, y0 + x, color);
-        drawLine(x0 - y, y0 - x, x0 - y, y0 + x, color);
+    for (const Span& span : spans) {
+        if (span.y < 0 || span.y >= height) continue;
+        int16_t x0 = std::max<int16_t>(span.x0, 0);
+        int16_t x1 = std::min<int16_t>(span.x1, width - 1);
+        if (x0 > x1) continue;
+
+        std::fill_n(&framebuffer[span.y * width + x0], x1 - x0 + 1, color);
+        min_x = std::min(min_x, x0);
+        max_x = std::max(max_x, x1);
+        min_y = std::min(min_y, span.y);
+        max_y = std::max(max_y, span.y);
+    }
+
+    // одна грязная область на всю фигуру
+    if (max_x >= 0) {
+        markDirty(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
     }
 }
 
@@ -190,62 +398,383 @@ void TFTDisplay::setFont(const Font& font) {
 }
 
 void TFTDisplay::drawText(int16_t x, int16_t y, const std::string& text, uint16_t color) {
-    // Basic font rendering implementation
-    const uint8_t* font_data = current_font.data;
-    int font_width = current_font.width;
-    int font_height = current_font.height;
+    const Font& font = current_font;
+    uint8_t row_bytes = font.rowBytes();
+    int16_t text_width = static_cast<int16_t>(text.length() * font.width);
 
     for (size_t i = 0; i < text.length(); i++) {
-        char c = text[i];
-        if (c < 32 || c > 126) continue;
-
-        const uint8_t* char_data = &font_data[(c - 32) * font_width * font_height / 8];
-        
-        for (int fy = 0; fy < font_height; fy++) {
-            for (int fx = 0; fx < font_width; fx++) {
-                if (char_data[fy * font_width / 8 + fx / 8] & (1 << (7 - fx % 8))) {
-                    drawPixel(x + i * font_width + fx, y + fy, color);
+        const uint8_t* glyph = font.glyph(text[i]);
+        if (!glyph) continue;
+
+        int16_t gx = x + i * font.width;
+        for (int fy = 0; fy < font.height; fy++) {
+            int16_t py = y + fy;
+            if (py < 0 || py >= height) continue;
+
+            const uint8_t* row = glyph + fy * row_bytes;
+            uint16_t* dst = &framebuffer[py * width];
+            for (int fx = 0; fx < font.width; fx++) {
+                int16_t px = gx + fx;
+                if (px >= 0 && px < width && (row[fx / 8] & (0x80 >> (fx % 8)))) {
+                    dst[px] = color;
                 }
             }
         }
     }
+
+    clipAndMarkDirty(x, y, text_width, font.height);
+}
+
+void TFTDisplay::drawText(int16_t x, int16_t y, const std::string& text, uint16_t color, uint16_t bg) {
+    const Font& font = current_font;
+    int16_t text_width = static_cast<int16_t>(text.length() * font.width);
+
+    // видимая часть строки
+    int16_t x0 = std::max<int16_t>(x, 0);
+    int16_t y0 = std::max<int16_t>(y, 0);
+    int16_t x1 = std::min<int16_t>(x + text_width, width);
+    int16_t y1 = std::min<int16_t>(y + font.height, height);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    for (size_t i = 0; i < text.length(); i++) {
+        int16_t gx = x + i * font.width;
+        int16_t cx0 = std::max(gx, x0);
+        int16_t cx1 = std::min<int16_t>(gx + font.width, x1);
+        if (cx0 >= cx1) continue;
+
+        // символ вне шрифта рисуется пустой ячейкой фона
+        const uint16_t* cell = glyph_cache.get(font, text[i], color, bg);
+        for (int16_t py = y0; py < y1; py++) {
+            uint16_t* dst = &framebuffer[py * width + cx0];
+            if (cell) {
+                std::memcpy(dst, &cell[(py - y) * font.width + (cx0 - gx)],
+                            (cx1 - cx0) * sizeof(uint16_t));
+            } else {
+                std::fill_n(dst, cx1 - cx0, bg);
+            }
+        }
+    }
+
+    markDirty(x0, y0, x1 - x0, y1 - y0);
 }
 
 void TFTDisplay::drawImage(int16_t x, int16_t y, int16_t w, int16_t h, const std::vector<uint16_t>& image_data) {
-    if (x < 0 || y < 0 || w <= 0 || h <= 0) return;
+    if (image_data.size() < static_cast<size_t>(w) * h) return;
+    blit(x, y, w, h, image_data.data(), w);
+}
+
+void TFTDisplay::blit(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t* pixels, int16_t stride) {
+    if (w <= 0 || h <= 0) return;
+
+    // при обрезке шаг строки источника остаётся исходным
+    if (x < 0) {
+        pixels -= x;
+        w += x;
+        x = 0;
+    }
+    if (y < 0) {
+        pixels -= static_cast<int32_t>(y) * stride;
+        h += y;
+        y = 0;
+    }
     if (x + w > width) w = width - x;
     if (y + h > height) h = height - y;
+    if (w <= 0 || h <= 0) return;
+
+    for (int16_t row = 0; row < h; row++) {
+        std::memcpy(&framebuffer[(y + row) * width + x],
+                    &pixels[row * stride],
+                    w * sizeof(uint16_t));
+    }
+    markDirty(x, y, w, h);
+}
+
+void TFTDisplay::drawImage(int16_t x, int16_t y, const Asset565& asset) {
+    if (!asset.isOpen()) return;
+
+    // нарисованное раньше уходит первым, иначе оно перекроет картинку на панели;
+    // после waitIdle поток отправки ждёт следующего present() и шину не трогает
+    present();
+    waitIdle();
+
+    std::vector<uint16_t> tile_pixels;
+    for (size_t i = 0; i < asset.getTileCount(); i++) {
+        Asset565::Tile tile = asset.getTile(i);
+        Rectangle rect(x + tile.rect.x, y + tile.rect.y, tile.rect.width, tile.rect.height);
+        bool inside = rect.x >= 0 && rect.y >= 0 &&
+                      rect.x + rect.width <= width && rect.y + rect.height <= height;
+
+        if (inside && !asset.isRLE() && asset.isBigEndian() &&
+            pixel_format->format == PixelFormat::RGB565 && scroll_offset == 0) {
+            // кадровый буфер должен совпадать с панелью для следующих present() и зеркал
+            const uint8_t* src = tile.data;
+            for (int16_t row = 0; row < rect.height; row++) {
+                uint16_t* dst = &framebuffer[(rect.y + row) * width + rect.x];
+                for (int16_t col = 0; col < rect.width; col++, src += 2) {
+                    dst[col] = (src[0] << 8) | src[1];
+                }
+                std::memcpy(&shadow[(rect.y + row) * width + rect.x], dst, rect.width * sizeof(uint16_t));
+            }
+
+            transaction.clear();
+            setAddressWindow(transaction, rect.x, rect.y, rect.x + rect.width - 1, rect.y + rect.height - 1);
+            transaction.dataRef(tile.data, tile.length);
+            spi.submit(transaction);
+            addDirtyRect(presented_rects, rect, MAX_DIRTY_RECTS);
+            continue;
+        }
+
+        tile_pixels.resize(static_cast<size_t>(rect.width) * rect.height);
+        if (asset.decodeTile(i, tile_pixels.data())) {
+            blit(rect.x, rect.y, rect.width, rect.height, tile_pixels.data(), rect.width);
+        }
+    }
 
-    setAddressWindow(x, y, x + w - 1, y + h - 1);
-    writeData(reinterpret_cast<const uint8_t*>(image_data.data()), w * h * 2);
+    present();
 }
 
-void TFTDisplay::writeCommand(uint8_t cmd) {
-    spi.setDC(false);
-    spi.write(&cmd, 1);
+void TFTDisplay::present() {
+    if (dirty_rects.empty()) return;
+
+    for (const Rectangle& rect : dirty_rects) {
+        addDirtyRect(presented_rects, rect, MAX_DIRTY_RECTS);
+    }
+
+    if (flush_mode == FlushMode::Sync) {
+        TraceEventRange events;
+        TRACE_EVENT_RANGE_ADD(events);
+        TRACE_FLUSH("TFTDisplay::flush", events);
+        PerfScope scope(perf, PerfTiming::Flush);
+        flushRects(framebuffer.data(), dirty_rects);
+        dirty_rects.clear();
+        if (perf) perf->add(PerfCounter::Flushes);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(flush_mutex);
+
+    // поток ещё не забрал предыдущий кадр - дописываем изменения в него,
+    // иначе заполняем буфер, который сейчас не отправляется
+    int slot = pending_frame;
+    if (slot < 0) {
+        slot = active_frame == 0 ? 1 : 0;
+        frames[slot].rects.clear();
+        frames[slot].events.clear();
+        frames[slot].pixels.resize(framebuffer.size());
+    }
+
+    // при слиянии области расширяются, поэтому копируем итоговые прямоугольники:
+    // вне грязных областей кадровый буфер совпадает с уже переданным
+    FlushFrame& frame = frames[slot];
+    TRACE_EVENT_RANGE_ADD(frame.events);
+    for (const Rectangle& rect : dirty_rects) {
+        addDirtyRect(frame.rects, rect, MAX_DIRTY_RECTS);
+    }
+    dirty_rects.clear();
+    for (const Rectangle& rect : frame.rects) {
+        for (int16_t row = rect.y; row < rect.y + rect.height; row++) {
+            std::memcpy(&frame.pixels[row * width + rect.x],
+                        &framebuffer[row * width + rect.x],
+                        rect.width * sizeof(uint16_t));
+        }
+    }
+
+    pending_frame = slot;
+    flush_cv.notify_one();
 }
 
-void TFTDisplay::writeData(const uint8_t* data, size_t length) {
-    spi.setDC(true);
-    spi.write(const_cast<uint8_t*>(data), length);
+bool TFTDisplay::takePresentedRects(std::vector<Rectangle>& rects) {
+    rects.clear();
+    rects.swap(presented_rects);
+    return !rects.empty();
 }
 
-void TFTDisplay::setAddressWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
-    writeCommand(0x2A); // установка столбцов
-    uint8_t data[4] = {
-        static_cast<uint8_t>(x0 >> 8),
-        static_cast<uint8_t>(x0 & 0xFF),
-        static_cast<uint8_t>(x1 >> 8),
-        static_cast<uint8_t>(x1 & 0xFF)
-    };
-    writeData(data, 4);
+void TFTDisplay::waitIdle() {
+    if (flush_mode == FlushMode::Sync) return;
+
+    std::unique_lock<std::mutex> lock(flush_mutex);
+    if (!flush_running) return;
+    idle_cv.wait(lock, [this] { return pending_frame < 0 && active_frame < 0; });
+}
 
-    writeCommand(0x2B); // установка строк
-    data[0] = static_cast<uint8_t>(y0 >> 8);
-    data[1] = static_cast<uint8_t>(y0 & 0xFF);
-    data[2] = static_cast<uint8_t>(y1 >> 8);
-    data[3] = static_cast<uint8_t>(y1 & 0xFF);
-    writeData(data, 4);
+void TFTDisplay::flushLoop() {
+    TRACE_THREAD_NAME("display flush");
+    std::unique_lock<std::mutex> lock(flush_mutex);
+    while (true) {
+        flush_cv.wait(lock, [this] { return pending_frame >= 0 || !flush_running; });
+        if (pending_frame < 0) break;
+
+        active_frame = pending_frame;
+        pending_frame = -1;
+        FlushFrame& frame = frames[active_frame];
+        lock.unlock();
+
+        try {
+            // SPI-отрезки выгрузки относятся к последнему событию кадра
+            TRACE_EVENT_RANGE_TAG(frame.events);
+            TRACE_FLUSH("TFTDisplay::flush", frame.events);
+            PerfScope scope(perf, PerfTiming::Flush);
+            flushRects(frame.pixels.data(), frame.rects);
+            if (perf) perf->add(PerfCounter::Flushes);
+        } catch (const std::exception& e) {
+            std::cerr << "Display flush failed: " << e.what() << std::endl;
+        }
+
+        lock.lock();
+        frame.rects.clear();
+        active_frame = -1;
+        idle_cv.notify_all();
+    }
+}
+
+void TFTDisplay::markDirty(int16_t x, int16_t y, int16_t w, int16_t h) {
+    addDirtyRect(dirty_rects, Rectangle(x, y, w, h), MAX_DIRTY_RECTS);
+}
+
+void TFTDisplay::clipAndMarkDirty(int16_t x, int16_t y, int16_t w, int16_t h) {
+    int16_t x0 = std::max<int16_t>(x, 0);
+    int16_t y0 = std::max<int16_t>(y, 0);
+    int16_t x1 = std::min<int16_t>(x + w, width);
+    int16_t y1 = std::min<int16_t>(y + h, height);
+    if (x0 < x1 && y0 < y1) {
+        markDirty(x0, y0, x1 - x0, y1 - y0);
+    }
+}
+
+void TFTDisplay::flushRects(const uint16_t* source, const std::vector<Rectangle>& rects) {
+    // пока копия неизвестна, сравнивать не с чем
+    const bool diff = diff_flush && shadow_valid;
+    const size_t window_bytes = flush_cost.windowBytes();
+    uint64_t saved_before = diff_stats.savedBytes();
+
+    for (const Rectangle& rect : rects) {
+        size_t pixels = static_cast<size_t>(rect.width) * rect.height;
+        diff_stats.rect_pixels += pixels;
+        diff_stats.rect_bytes += window_bytes + pixel_format->packed_size(pixels);
+
+        flush_windows.clear();
+        if (diff) {
+            diff_stats.changed_pixels += flush_planner.plan(source, shadow.data(), width, rect,
+                                                            *pixel_format, flush_cost, flush_windows);
+            // окна вышли дороже области целиком - шлём её одним окном
+            size_t planned = 0;
+            for (const Rectangle& window : flush_windows) {
+                planned += window_bytes + pixel_format->packed_size(static_cast<size_t>(window.width) * window.height);
+            }
+            if (planned > window_bytes + pixel_format->packed_size(pixels)) {
+                flush_windows.assign(1, rect);
+            }
+        } else {
+            diff_stats.changed_pixels += pixels;
+            flush_windows.push_back(rect);
+        }
+        for (const Rectangle& window : flush_windows) {
+            size_t window_pixels = static_cast<size_t>(window.width) * window.height;
+            diff_stats.sent_pixels += window_pixels;
+            diff_stats.sent_bytes += window_bytes + pixel_format->packed_size(window_pixels);
+            diff_stats.windows++;
+            flushRect(source, width, window);
+        }
+
+        for (int16_t row = rect.y; row < rect.y + rect.height; row++) {
+            std::memcpy(&shadow[row * width + rect.x], &source[row * width + rect.x],
+                        rect.width * sizeof(uint16_t));
+        }
+        if (rect.x == 0 && rect.y == 0 && rect.width == width && rect.height == height) {
+            shadow_valid = true;
+        }
+    }
+
+    diff_stats.flushes++;
+    if (perf) perf->add(PerfCounter::DiffSavedBytes, diff_stats.savedBytes() - saved_before);
+}
+
+void TFTDisplay::rotateShadowRows(int16_t top, int16_t height, int16_t shift) {
+    // строка top + k получает строку top + (k + shift) % height
+    auto first = shadow.begin() + static_cast<size_t>(top) * width;
+    std::rotate(first, first + static_cast<size_t>(shift % height) * width,
+                first + static_cast<size_t>(height) * width);
+}
+
+void TFTDisplay::flushRect(const uint16_t* source, int stride, const Rectangle& rect) {
+    if (scroll_offset == 0) {
+        flushWindow(source, stride, rect, rect.y);
+        return;
+    }
+
+    // полоса прокрутки в памяти панели сдвинута: область режется по её
+    // границам и по строке, где память заворачивает к началу полосы
+    int16_t bottom = scroll_top + scroll_height;
+    int16_t wrap = bottom - scroll_offset;
+    int16_t cuts[] = {scroll_top, wrap, bottom, static_cast<int16_t>(rect.y + rect.height)};
+
+    int16_t y = rect.y;
+    for (int16_t cut : cuts) {
+        if (cut <= y) continue;
+        int16_t end = std::min<int16_t>(cut, rect.y + rect.height);
+
+        int16_t gram_y = y;
+        if (y >= scroll_top && y < wrap) {
+            gram_y = y + scroll_offset;
+        } else if (y >= wrap && y < bottom) {
+            gram_y = y + scroll_offset - scroll_height;
+        }
+        flushWindow(source, stride, Rectangle(rect.x, y, rect.width, end - y), gram_y);
+
+        y = end;
+        if (y >= rect.y + rect.height) break;
+    }
+}
+
+void TFTDisplay::flushWindow(const uint16_t* source, int stride, const Rectangle& rect, int16_t gram_y) {
+    size_t num_pixels = static_cast<size_t>(rect.width) * rect.height;
+
+    // упаковка в формат шины заодно собирает строки окна подряд
+    transfer_buffer.resize(pixel_format->packed_size(num_pixels));
+    size_t length = pixel_format->pack_rect(&source[rect.y * stride + rect.x], stride,
+                                            rect.width, rect.height, transfer_buffer.data());
+
+    // окно адресов и пиксели уходят одной транзакцией
+    transaction.clear();
+    setAddressWindow(transaction, rect.x, gram_y, rect.x + rect.width - 1, gram_y + rect.height - 1);
+    transaction.dataRef(transfer_buffer.data(), length);
+    spi.submit(transaction);
+}
+
+void TFTDisplay::writeCommand(uint8_t cmd, const uint8_t* params, size_t length) {
+    transaction.clear();
+    transaction.command(cmd, params, length);
+    spi.submit(transaction);
+}
+
+void TFTDisplay::setAddressWindow(SPITransaction& txn, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+    int32_t columns = (x0 << 16) | x1;
+    int32_t rows = (y0 << 16) | y1;
+    if (perf && (columns != window_columns || rows != window_rows)) {
+        perf->add(PerfCounter::WindowSetups);
+    }
+
+    if (columns != window_columns) {
+        uint8_t data[4] = {
+            static_cast<uint8_t>(x0 >> 8),
+            static_cast<uint8_t>(x0 & 0xFF),
+            static_cast<uint8_t>(x1 >> 8),
+            static_cast<uint8_t>(x1 & 0xFF)
+        };
+        txn.command(0x2A, data, 4); // установка столбцов
+        window_columns = columns;
+    }
+
+    if (rows != window_rows) {
+        uint8_t data[4] = {
+            static_cast<uint8_t>(y0 >> 8),
+            static_cast<uint8_t>(y0 & 0xFF),
+            static_cast<uint8_t>(y1 >> 8),
+            static_cast<uint8_t>(y1 & 0xFF)
+        };
+        txn.command(0x2B, data, 4); // установка строк
+        window_rows = rows;
+    }
 
-    writeCommand(0x2C); // запись в память
+    txn.command(0x2C); // запись в память
 } 
\ No newline at end of file
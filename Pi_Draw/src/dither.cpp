@@ -0,0 +1,136 @@
+#include "dither.h"
+#include <algorithm>
+
+namespace {
+
+const uint8_t BAYER4[4][4] = {
+    { 0,  8,  2, 10},
+    {12,  4, 14,  6},
+    { 3, 11,  1,  9},
+    {15,  7, 13,  5}
+};
+
+const uint8_t BAYER8[8][8] = {
+    { 0, 32,  8, 40,  2, 34, 10, 42},
+    {48, 16, 56, 24, 50, 18, 58, 26},
+    {12, 44,  4, 36, 14, 46,  6, 38},
+    {60, 28, 52, 20, 62, 30, 54, 22},
+    { 3, 35, 11, 43,  1, 33,  9, 41},
+    {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47,  7, 39, 13, 45,  5, 37},
+    {63, 31, 55, 23, 61, 29, 53, 21}
+};
+
+// ближайший уровень канала из bits бит, развёрнутый обратно в 8 бит
+inline int quantize(int value, int bits) {
+    int max_level = (1 << bits) - 1;
+    int level = (value * max_level + 127) / 255;
+    return (level << (8 - bits)) | (level >> (2 * bits - 8));
+}
+
+} // namespace
+
+Ditherer::Ditherer(DitherMode mode)
+    : mode(mode), width(0), x_offset(0), next_row(0), bias() {
+}
+
+void Ditherer::begin(int width, int x_offset) {
+    this->width = width;
+    this->x_offset = x_offset;
+    next_row = -1;
+    if (isErrorDiffusion()) {
+        errors_current.assign((width + 2) * 3, 0);
+        errors_next.assign((width + 2) * 3, 0);
+    }
+}
+
+const pixel_convert::DitherBias* Ditherer::rowBias(int y) {
+    if (!isOrdered()) return nullptr;
+
+    // пороги растянуты на шаг квантования: от 0 до 7 для 5 бит, до 3 для 6 бит
+    int size = mode == DitherMode::Bayer4 ? 4 : 8;
+    int levels = size * size;
+    for (int i = 0; i < 16; i++) {
+        int x = (i + x_offset) & (size - 1);
+        int m = size == 4 ? BAYER4[y & 3][x] : BAYER8[y & 7][x];
+        bias.rb[i] = (2 * m + 1) * 4 / levels;
+        bias.g[i] = (2 * m + 1) * 2 / levels;
+    }
+    return &bias;
+}
+
+void Ditherer::bgr24Row(const uint8_t* src, uint16_t* dst, int y) {
+    if (isErrorDiffusion()) {
+        diffuseRow<3>(src, dst, y);
+    } else {
+        pixel_convert::bgr24ToRGB565(src, dst, width, rowBias(y));
+    }
+}
+
+void Ditherer::bgrx32Row(const uint8_t* src, uint16_t* dst, int y) {
+    if (isErrorDiffusion()) {
+        diffuseRow<4>(src, dst, y);
+    } else {
+        pixel_convert::bgrx32ToRGB565(src, dst, width, rowBias(y));
+    }
+}
+
+void Ditherer::indexedRow(const uint8_t* indices, const uint8_t* palette_bgr, uint16_t* dst, int y) {
+    bgr_row.resize(width * 3);
+    uint8_t* out = bgr_row.data();
+    for (int x = 0; x < width; x++) {
+        const uint8_t* color = palette_bgr + indices[x] * 3;
+        *out++ = color[0];
+        *out++ = color[1];
+        *out++ = color[2];
+    }
+    bgr24Row(bgr_row.data(), dst, y);
+}
+
+template <int BPP>
+void Ditherer::diffuseRow(const uint8_t* src, uint16_t* dst, int y) {
+    // строки не подряд - накопленная ошибка относится к другому месту
+    if (y != next_row) {
+        std::fill(errors_current.begin(), errors_current.end(), 0);
+        std::fill(errors_next.begin(), errors_next.end(), 0);
+    }
+    next_row = y + 1;
+
+    const bool atkinson = mode == DitherMode::Atkinson;
+    int16_t* current = errors_current.data() + 3;
+    int16_t* next = errors_next.data() + 3;
+    // ошибка, уходящая вправо по строке: в x + 1 и (Аткинсон) в x + 2
+    int carry1[3] = {0, 0, 0};
+    int carry2[3] = {0, 0, 0};
+
+    for (int x = 0; x < width; x++) {
+        const uint8_t* p = src + x * BPP;
+        int out[3];
+        for (int c = 0; c < 3; c++) {
+            int i = x * 3 + c;
+            int value = std::min(255, std::max(0, p[c] + current[i] + carry1[c]));
+            out[c] = quantize(value, c == 1 ? 6 : 5);
+            int error = value - out[c];
+
+            if (atkinson) {
+                int part = error / 8;
+                carry1[c] = carry2[c] + part;
+                carry2[c] = part;
+                next[i - 3] += part;
+                next[i] += part;
+                next[i + 3] += part;
+                // ячейка текущей строки прочитана, теперь это строка y + 2
+                current[i] = part;
+            } else {
+                carry1[c] = error * 7 / 16;
+                next[i - 3] += error * 3 / 16;
+                next[i] += error * 5 / 16;
+                next[i + 3] += error / 16;
+                current[i] = 0;
+            }
+        }
+        dst[x] = RGB565(out[2], out[1], out[0]);
+    }
+
+    errors_current.swap(errors_next);
+}
@@ -1,109 +1,65 @@
-#include <display_types.h>
+#include <display_pi.h>
 #include <colors.h>
+#include <fonts.h>
+#include <undo_history.h>
+#include <x11_mirror.h>
+#include <text_console.h>
+#include <input_reader.h>
 #include <iostream>
 #include <termios.h>
 #include <unistd.h>
+#include <poll.h>
+#include <cerrno>
 #include <cstring>
 #include <vector>
 #include <algorithm>
-#include <X11/Xlib.h>
-#include <X11/Xutil.h>
-#include <linux/input.h>
-#include <fcntl.h>
-#include <thread>
-#include <atomic>
-#include <chrono>
-#include <mutex>
 
 class DrawingApp {
 private:
-    tft_display_pi::TFTDisplay& display;
+    TFTDisplay& display;
     int16_t cursor_x;
     int16_t cursor_y;
     uint16_t current_color;
     bool is_drawing;
     char current_char;
-    tft_display::Font font;
-    std::vector<std::pair<int16_t, int16_t>> drawing_points;
+    Font font;
+    UndoHistory history;
     bool show_cursor;
+    // курсор в кадре и пиксель, который он закрыл
+    bool cursor_drawn;
+    uint16_t under_cursor;
     int brush_size;
-    std::atomic<bool> mouse_thread_running;
-    std::thread mouse_thread;
-    Display* x_display;
-    Window window;
-    GC gc;
-    int screen_width;
-    int screen_height;
-    XImage* x_image;
-    std::vector<uint8_t> image_buffer;
-    std::mutex display_mutex;
+    // дисплей, история и курсор принадлежат потоку run(): поток ввода
+    // только кладёт события в очередь и будит его через eventfd
+    InputReader input;
+    bool running;
+    bool text_mode;
+    bool left_down;
+    uint64_t last_left_click_ms;
+    static constexpr uint64_t DOUBLE_CLICK_MS = 300;
+    // зеркало в окне X11 с увеличением, обновляется только по изменённым областям
+    static constexpr int MIRROR_ZOOM = 3;
+    X11Mirror mirror;
+    std::vector<Rectangle> mirror_rects;
+    // консоль текстового режима внизу экрана, прокручивается аппаратно
+    static constexpr int16_t CONSOLE_TOP = 112;
+    static constexpr char KEY_CTRL_T = 0x14;
+    TextConsole console;
+    // вывод консоли с последнего снимка полосы ещё не в истории отмены
+    bool console_dirty;
 
     struct termios old_settings, new_settings;
 
     void setup_x11() {
-        x_display = XOpenDisplay(nullptr);
-        if (!x_display) {
-            std::cerr << "Не удалось подключиться к серверу\n";
-            return;
-        }
-
-        int screen = DefaultScreen(x_display);
-        screen_width = DisplayWidth(x_display, screen);
-        screen_height = DisplayHeight(x_display, screen);
-
-        // Создаем окно
-        window = XCreateSimpleWindow(x_display, RootWindow(x_display, screen),
-                                    0, 0, 128, 160, 1,
-                                    BlackPixel(x_display, screen),
-                                    WhitePixel(x_display, screen));
-        
-        // Устанавливаем заголовок окна
-        XStoreName(x_display, window, "TFT Display Mirror");
-        
-        // Показываем окно
-        XMapWindow(x_display, window);
-        
-        // Создаем графический контекст
-        gc = XCreateGC(x_display, window, 0, nullptr);
-        
-        //  буфер для изображения
-        image_buffer.resize(128 * 160 * 4); // 4 байта на пиксель RGBA
-        x_image = XCreateImage(x_display, DefaultVisual(x_display, screen),
-                              24, ZPixmap, 0,
-                              reinterpret_cast<char*>(image_buffer.data()),
-                              128, 160, 32, 0);
+        mirror.open("TFT Display Mirror");
     }
 
     void update_mirror_display() {
-        if (!x_display) return;
+        if (!mirror.isOpen()) return;
 
-        std::lock_guard<std::mutex> lock(display_mutex);
-        
-        // Очищаем буфер
-        std::fill(image_buffer.begin(), image_buffer.end(), 0);
-        
-        // Копируем текущее изображение с TFT дисплея
-        for (const auto& point : drawing_points) {
-            int index = (point.second * 128 + point.first) * 4;
-            uint16_t color = current_color;
-            image_buffer[index] = (color >> 8) & 0xF8;     // R
-            image_buffer[index + 1] = (color >> 3) & 0xFC; // G
-            image_buffer[index + 2] = (color << 3) & 0xF8; // B
-            image_buffer[index + 3] = 0xFF;                // A
-        }
-        
-        // Отображаем курсор
-        if (show_cursor) {
-            int index = (cursor_y * 128 + cursor_x) * 4;
-            image_buffer[index] = 0xFF;     // R
-            image_buffer[index + 1] = 0xFF; // G
-            image_buffer[index + 2] = 0xFF; // B
-            image_buffer[index + 3] = 0xFF; // A
-        }
-        
-        // Обновляем окно
-        XPutImage(x_display, window, gc, x_image, 0, 0, 0, 0, 128, 160);
-        XFlush(x_display);
+        // на панель ничего не ушло - окно не трогаем
+        display.takePresentedRects(mirror_rects);
+        mirror.update(display.getPixels(), display.getWidth(), mirror_rects);
     }
 
     void setup_terminal() {
@@ -121,42 +77,47 @@ private:
         int16_t new_x = std::max(0, std::min(127, cursor_x + dx));
         int16_t new_y = std::max(0, std::min(159, cursor_y + dy));
         
-        if (new_x != cursor_x || new_y != cursor_y) {
-            if (show_cursor) {
-                display.drawPixel(cursor_x, cursor_y, colors::BLACK);
-            }
-            cursor_x = new_x;
-            cursor_y = new_y;
-            if (show_cursor) {
-                display.drawPixel(cursor_x, cursor_y, colors::WHITE);
-            }
-        }
+        cursor_x = new_x;
+        cursor_y = new_y;
+    }
+
+    // курсор рисуется поверх кадра только между событиями: история
+    // снимает контрольные точки с кадра, и курсор, попавший в тайл,
+    // вернулся бы при отмене на старое место
+    void hide_cursor() {
+        if (!cursor_drawn) return;
+        display.drawPixel(cursor_x, cursor_y, under_cursor);
+        cursor_drawn = false;
+    }
+
+    void draw_cursor() {
+        if (!show_cursor) return;
+        under_cursor = display.getPixels()[cursor_y * display.getWidth() + cursor_x];
+        display.drawPixel(cursor_x, cursor_y, COLOR_WHITE);
+        cursor_drawn = true;
     }
 
     void change_color() {
         static const uint16_t colors[] = {
-            colors::RED, colors::GREEN, colors::BLUE,
-            colors::YELLOW, colors::CYAN, colors::MAGENTA,
-            colors::WHITE, colors::BLACK
+            COLOR_RED, COLOR_GREEN, COLOR_BLUE,
+            COLOR_YELLOW, COLOR_CYAN, COLOR_MAGENTA,
+            COLOR_WHITE, COLOR_BLACK
         };
         static int color_index = 0;
         color_index = (color_index + 1) % 8;
         current_color = colors[color_index];
+        history.endStroke(); // новый цвет - новый мазок
         std::cout << "Текущий цвет: " << color_index + 1 << "/8\n";
     }
 
     void change_brush_size() {
         brush_size = (brush_size % 3) + 1;
+        history.endStroke();
         std::cout << "Размер кисти: " << brush_size << "\n";
     }
 
     void draw_with_brush(int16_t x, int16_t y) {
-        if (brush_size == 1) {
-            display.drawPixel(x, y, current_color);
-        } else {
-            int radius = brush_size - 1;
-            display.fillCircle(x, y, radius, current_color);
-        }
+        UndoHistory::stampBrush(display, x, y, brush_size, current_color);
     }
 
     void print_help() {
@@ -166,8 +127,10 @@ private:
                   << "c - смена цвета\n"
                   << "b - изменение размера кисти\n"
                   << "e - очистка экрана\n"
-                  << "t - режим ввода текста\n"
+                  << "t - режим ввода текста (Ctrl+T - выход)\n"
                   << "s - показать/скрыть курсор\n"
+                  << "u - отменить последнее действие\n"
+                  << "y - повторить отменённое действие\n"
                   << "q - выход\n"
                   << "\nУправление мышью:\n"
                   << "Левая кнопка - рисование\n"
@@ -177,238 +140,257 @@ private:
                   << "Скролл - изменение размера кисти\n";
     }
 
-    void save_drawing_point() {
-        drawing_points.emplace_back(cursor_x, cursor_y);
+    // текст консоли - тоже изменение кадра: перед каждым действием истории
+    // полоса сохраняется снимком, и отмена не затирает её старыми тайлами
+    void commit_console() {
+        if (!console_dirty) return;
+        console_dirty = false;
+        history.recordSnapshot(CONSOLE_TOP, display.getHeight() - CONSOLE_TOP);
     }
 
-    void undo_last_action() {
-        if (!drawing_points.empty()) {
-            display.clearScreen(colors::BLACK);
-            drawing_points.pop_back();
-            for (const auto& point : drawing_points) {
-                draw_with_brush(point.first, point.second);
-            }
+    // точка мазка под курсором; стоящий на месте курсор не перерисовывается
+    void paint_at_cursor() {
+        if (!history.inStroke()) {
+            commit_console();
+            history.beginStroke(current_color, brush_size);
+        }
+        if (history.addPoint(cursor_x, cursor_y)) {
+            draw_with_brush(cursor_x, cursor_y);
         }
     }
 
-    void mouse_event_handler() {
-        int mouse_fd = open("/dev/input/mice", O_RDONLY);
-        if (mouse_fd < 0) {
-            std::cerr << "Мышь не найдена\n";
-            return;
+    void clear_drawing() {
+        commit_console();
+        display.clearScreen(COLOR_BLACK);
+        history.recordClear(COLOR_BLACK);
+    }
+
+    void undo_last_action() {
+        commit_console();
+        history.undo();
+    }
+
+    void redo_last_action() {
+        // новый вывод консоли, как и любое действие, отменяет повтор
+        commit_console();
+        history.redo();
+    }
+
+    // ждать событий ввода; заодно просыпаемся на события окна-зеркала
+    void wait_for_input() {
+        pollfd fds[2] = {
+            {input.wakeFd(), POLLIN, 0},
+            {mirror.connectionFd(), POLLIN, 0}
+        };
+        int count = fds[1].fd >= 0 ? 2 : 1;
+        // Expose, прочитанный Xlib при выводе зеркала, сокет уже не покажет
+        int timeout = mirror.hasQueuedEvents() ? 0 : -1;
+        while (poll(fds, count, timeout) < 0 && errno == EINTR) {
         }
+    }
 
-        unsigned char data[3];
-        int left_button = 0;
-        int right_button = 0;
-        int middle_button = 0;
-        int x = 0, y = 0;
-        int last_left_click_time = 0;
-        const int DOUBLE_CLICK_TIME = 300; 
-
-        while (mouse_thread_running) {
-            if (read(mouse_fd, data, sizeof(data)) == sizeof(data)) {
-                left_button = data[0] & 0x1;
-                right_button = data[0] & 0x2;
-                middle_button = data[0] & 0x4;
-                x = data[1];
-                y = data[2];
-
-                // скролл
-                if (data[0] & 0x8) { // вверх
-                    change_brush_size();
-                } else if (data[0] & 0x10) { // вниз
-                    change_brush_size();
-                }
+    void handle_event(const InputEvent& event) {
+        hide_cursor();
 
-                // Масштабирование
-                int16_t new_x = cursor_x + x;
-                int16_t new_y = cursor_y - y;
+        switch (event.type) {
+            case InputEventType::Key:
+                if (text_mode) {
+                    handle_text_key(event.key);
+                } else {
+                    handle_key(event.key);
+                }
+                break;
 
-                // Ограничиваем координаты размерами дисплея -1
-                new_x = std::max(0, std::min(127, new_x));
-                new_y = std::max(0, std::min(159, new_y));
+            case InputEventType::Arrow:
+                if (!text_mode) {
+                    move_cursor(event.dx, event.dy);
+                }
+                break;
 
-                if (new_x != cursor_x || new_y != cursor_y) {
-                    if (show_cursor) {
-                        display.drawPixel(cursor_x, cursor_y, colors::BLACK);
-                    }
-                    cursor_x = new_x;
-                    cursor_y = new_y;
-                    if (show_cursor) {
-                        display.drawPixel(cursor_x, cursor_y, colors::WHITE);
-                    }
+            case InputEventType::MouseMove:
+                move_cursor(event.dx, event.dy);
+                if (left_down) {
+                    paint_at_cursor();
                 }
+                break;
+
+            case InputEventType::MouseButton:
+                handle_mouse_button(event);
+                break;
+
+            case InputEventType::MouseWheel: // скролл
+                change_brush_size();
+                break;
+        }
+
+        if (is_drawing && !text_mode) {
+            paint_at_cursor();
+        }
+        draw_cursor();
+    }
 
-                // дабл клик
-                if (left_button) {
-                    int current_time = std::chrono::duration_cast<std::chrono::milliseconds>(
-                        std::chrono::system_clock::now().time_since_epoch()
-                    ).count();
-                    
-                    if (current_time - last_left_click_time < DOUBLE_CLICK_TIME) {
-                        change_color(); // Двойной клик - смена цвета
+    void handle_mouse_button(const InputEvent& event) {
+        switch (event.button) {
+            case MouseButton::Left:
+                left_down = event.pressed;
+                if (event.pressed) {
+                    // дабл клик - смена цвета
+                    if (event.time_ms - last_left_click_ms < DOUBLE_CLICK_MS) {
+                        change_color();
                     }
-                    last_left_click_time = current_time;
-                    
-                    draw_with_brush(cursor_x, cursor_y);
-                    save_drawing_point();
+                    last_left_click_ms = event.time_ms;
+                    paint_at_cursor();
+                } else {
+                    history.endStroke();
                 }
-                
-                if (right_button) {
+                break;
+
+            case MouseButton::Right:
+                if (event.pressed) {
                     undo_last_action();
                 }
+                break;
 
-                if (middle_button) {
-                    display.clearScreen(colors::BLACK);
-                    drawing_points.clear();
+            case MouseButton::Middle:
+                if (event.pressed) {
+                    clear_drawing();
                 }
-            }
+                break;
         }
+    }
+
+    void handle_key(char key) {
+        switch (key) {
+            case 'q': // Выход
+                running = false;
+                break;
+
+            case ' ': // Рисование/стоп
+                is_drawing = !is_drawing;
+                if (is_drawing) {
+                    paint_at_cursor();
+                } else {
+                    history.endStroke();
+                }
+                break;
+
+            case 'c': // Смена цвета
+                change_color();
+                break;
+
+            case 'b': // Изменение размера кисти
+                change_brush_size();
+                break;
+
+            case 'e': // Очистка экрана
+                clear_drawing();
+                break;
+
+            case 't': // Режим ввода текста
+                text_mode = console.open();
+                if (text_mode) {
+                    // open() очищает полосу
+                    console_dirty = true;
+                    console.setColors(current_color, COLOR_BLACK);
+                    std::cout << "Режим ввода текста включен (выход - Ctrl+T)\n";
+                }
+                break;
+
+            case 's': // Показать/скрыть курсор
+                show_cursor = !show_cursor;
+                break;
+
+            case 'u': // Отменить последнее действие
+                undo_last_action();
+                break;
 
-        close(mouse_fd);
+            case 'y': // Повторить отменённое действие
+                redo_last_action();
+                break;
+
+            default:
+                break;
+        }
     }
 
 public:
-    DrawingApp(tft_display_pi::TFTDisplay& disp) 
+    DrawingApp(TFTDisplay& disp) 
         : display(disp), cursor_x(64), cursor_y(80), 
-          current_color(colors::WHITE), is_drawing(false), 
-          current_char('A'), show_cursor(true), brush_size(1),
-          mouse_thread_running(true), x_display(nullptr) {
-        font.width = 5;
-        font.height = 7;
-        font.first_char = ' ';
-        font.last_char = '~';
-        font.data = nullptr;
+          current_color(COLOR_WHITE), is_drawing(false), 
+          current_char('A'), history(disp), show_cursor(true),
+          cursor_drawn(false), under_cursor(COLOR_BLACK), brush_size(1),
+          running(false), text_mode(false), left_down(false), last_left_click_ms(0),
+          mirror(disp.getWidth(), disp.getHeight(), MIRROR_ZOOM),
+          console(disp, CONSOLE_TOP), console_dirty(false) {
+        font = FONT_5X7;
+        display.setFont(font);
 
         setup_x11();
-        mouse_thread = std::thread(&DrawingApp::mouse_event_handler, this);
-    }
-
-    ~DrawingApp() {
-        mouse_thread_running = false;
-        if (mouse_thread.joinable()) {
-            mouse_thread.join();
-        }
-        if (x_display) {
-            XDestroyImage(x_image);
-            XFreeGC(x_display, gc);
-            XDestroyWindow(x_display, window);
-            XCloseDisplay(x_display);
-        }
     }
 
     void run() {
         setup_terminal();
-        display.clearScreen(colors::BLACK);
+        display.clearScreen(COLOR_BLACK);
+        draw_cursor();
         print_help();
 
-        char key;
-        bool running = true;
-        bool text_mode = false;
+        if (!input.start()) {
+            restore_terminal();
+            return;
+        }
+
+        running = true;
+        text_mode = false;
 
         while (running) {
-          
+            display.present();
             update_mirror_display();
 
-            //клава
-            if (kbhit()) {
-                key = getchar();
-                
-                switch (key) {
-                    case 'q': // Выход
-                        running = false;
-                        break;
-
-                    case ' ': // Рисование/стоп
-                        is_drawing = !is_drawing;
-                        if (is_drawing) {
-                            save_drawing_point();
-                        }
-                        break;
-
-                    case 'c': // Смена цвета
-                        change_color();
-                        break;
-
-                    case 'b': // Изменение размера кисти
-                        change_brush_size();
-                        break;
-
-                    case 'e': // Очистка экрана
-                        display.clearScreen(colors::BLACK);
-                        drawing_points.clear();
-                        break;
-
-                    case 't': // Режим ввода текста
-                        text_mode = !text_mode;
-                        std::cout << (text_mode ? "Режим ввода текста включен\n" : "Режим ввода текста выключен\n");
-                        break;
-
-                    case 's': // Показать/скрыть курсор
-                        show_cursor = !show_cursor;
-                        if (show_cursor) {
-                            display.drawPixel(cursor_x, cursor_y, colors::WHITE);
-                        } else {
-                            display.drawPixel(cursor_x, cursor_y, colors::BLACK);
-                        }
-                        break;
-
-                    case 'u': // Отменить последнее действие
-                        undo_last_action();
-                        break;
-
-                    case 27: // Escape sequence для стрелок
-                        if (getchar() == '[') {
-                            switch (getchar()) {
-                                case 'A': // Вверх
-                                    move_cursor(0, -1);
-                                    break;
-                                case 'B': // Вниз
-                                    move_cursor(0, 1);
-                                    break;
-                                case 'C': // Вправо
-                                    move_cursor(1, 0);
-                                    break;
-                                case 'D': // Влево
-                                    move_cursor(-1, 0);
-                                    break;
-                            }
-                        }
-                        break;
-
-                    default:
-                        if (text_mode && key >= ' ' && key <= '~') {
-                            display.drawText(cursor_x, cursor_y, std::string(1, key), current_color);
-                            cursor_x += font.width;
-                            if (cursor_x >= 128) {
-                                cursor_x = 0;
-                                cursor_y += font.height;
-                                if (cursor_y >= 160) cursor_y = 0;
-                            }
-                        }
-                        break;
-                }
+            wait_for_input();
+            // сначала сброс eventfd, потом очередь: событие, пришедшее
+            // во время разбора, разбудит следующий проход
+            input.clearWakeup();
+            InputEvent event;
+            while (running && input.pop(event)) {
+                handle_event(event);
             }
-
-            if (is_drawing && !text_mode) {
-                draw_with_brush(cursor_x, cursor_y);
-                save_drawing_point();
-            }
-
-            // задержка для снижения нагрузки на CPU
-            std::this_thread::sleep_for(std::chrono::milliseconds(16));
         }
 
+        input.stop();
+        if (input.droppedEvents() > 0) {
+            std::cerr << "Потеряно событий ввода: " << input.droppedEvents() << "\n";
+        }
         restore_terminal();
     }
 
 private:
-    int kbhit() {
-        struct timeval tv = { 0L, 0L };
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(0, &fds);
-        return select(1, &fds, NULL, NULL, &tv);
+    // в режиме текста все клавиши идут в консоль, Ctrl+T - выход
+    void handle_text_key(char key) {
+        if (key == KEY_CTRL_T) {
+            console.close();
+            commit_console();
+            text_mode = false;
+            std::cout << "Режим ввода текста выключен\n";
+        } else if (key == 127) {
+            console.putChar('\b');
+            console_dirty = true;
+        } else if (key == '\n' || key == '\t' || (key >= ' ' && key <= '~')) {
+            console.putChar(key);
+            console_dirty = true;
+        }
     }
-}; 
+};
+
+// терминальная версия: стрелки и мышь рисуют прямо на панели,
+// копия экрана - в окне X11
+int main() {
+    TFTDisplay display(0, 25, 24, 128, 160);
+    if (!display.init()) {
+        std::cerr << "Не удалось инициализировать дисплей\n";
+        return 1;
+    }
+
+    DrawingApp app(display);
+    app.run();
+    return 0;
+}
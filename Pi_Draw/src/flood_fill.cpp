@@ -0,0 +1,124 @@
+#include "flood_fill.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// совпадение цвета с допуском; каналы RGB565 сравниваются в 8-битной шкале
+class ColorMatch {
+public:
+    ColorMatch(uint16_t target, uint8_t tolerance) : target(target), tolerance(tolerance) {
+        expand(target, r, g, b);
+    }
+
+    bool operator()(uint16_t color) const {
+        if (color == target) return true;
+        if (tolerance == 0) return false;
+        int cr, cg, cb;
+        expand(color, cr, cg, cb);
+        return std::abs(cr - r) <= tolerance && std::abs(cg - g) <= tolerance &&
+               std::abs(cb - b) <= tolerance;
+    }
+
+private:
+    uint16_t target;
+    int tolerance;
+    int r, g, b;
+
+    static void expand(uint16_t c, int& r, int& g, int& b) {
+        int r5 = (c >> 11) & 0x1F;
+        int g6 = (c >> 5) & 0x3F;
+        int b5 = c & 0x1F;
+        r = (r5 << 3) | (r5 >> 2);
+        g = (g6 << 2) | (g6 >> 4);
+        b = (b5 << 3) | (b5 >> 2);
+    }
+};
+
+} // namespace
+
+void FloodFill::fill(const uint16_t* pixels, int width, int height, int16_t x, int16_t y,
+                     uint8_t tolerance, FillConnectivity connectivity, std::vector<Span>& spans) {
+    if (x < 0 || y < 0 || x >= width || y >= height) return;
+
+    ColorMatch match(pixels[y * width + x], tolerance);
+    // у 8-связной области соседняя строка просматривается на пиксель шире
+    const int grow = connectivity == FillConnectivity::Eight ? 1 : 0;
+
+    visited.assign(static_cast<size_t>(width) * height, 0);
+    pending.clear();
+    pending.push_back({y, x, x});
+    int16_t min_y = y, max_y = y;
+
+    while (!pending.empty()) {
+        Span scan = pending.back();
+        pending.pop_back();
+
+        const uint16_t* row = pixels + scan.y * width;
+        uint8_t* seen = &visited[scan.y * width];
+        int px = scan.x0;
+        while (px <= scan.x1) {
+            if (seen[px] || !match(row[px])) {
+                px++;
+                continue;
+            }
+
+            // отрезок может выйти за просматриваемый диапазон в обе стороны
+            int left = px;
+            while (left > 0 && !seen[left - 1] && match(row[left - 1])) left--;
+            int right = px;
+            while (right < width - 1 && !seen[right + 1] && match(row[right + 1])) right++;
+
+            std::memset(seen + left, 1, right - left + 1);
+            min_y = std::min(min_y, scan.y);
+            max_y = std::max(max_y, scan.y);
+
+            // обе соседние строки: строка, откуда пришли, уже отмечена
+            // и отсеется проверкой seen
+            int16_t x0 = static_cast<int16_t>(std::max(left - grow, 0));
+            int16_t x1 = static_cast<int16_t>(std::min(right + grow, width - 1));
+            if (scan.y > 0) pending.push_back({static_cast<int16_t>(scan.y - 1), x0, x1});
+            if (scan.y < height - 1) pending.push_back({static_cast<int16_t>(scan.y + 1), x0, x1});
+
+            // right + 1 уже не подходит
+            px = right + 2;
+        }
+    }
+
+    // отрезки собираются по маске, а не по ходу обхода: так они сразу
+    // идут по строкам и слиты, сортировать тысячи кусков сложной области не нужно
+    for (int16_t row = min_y; row <= max_y; row++) {
+        const uint8_t* seen = &visited[row * width];
+        int px = 0;
+        while (px < width) {
+            if (!seen[px]) {
+                px++;
+                continue;
+            }
+            int start = px;
+            while (px < width && seen[px]) px++;
+            spans.push_back({row, static_cast<int16_t>(start), static_cast<int16_t>(px - 1)});
+        }
+    }
+}
+
+void FloodFill::replace(const uint16_t* pixels, int width, int height, uint16_t target,
+                        uint8_t tolerance, std::vector<Span>& spans) {
+    ColorMatch match(target, tolerance);
+
+    for (int y = 0; y < height; y++) {
+        const uint16_t* row = pixels + y * width;
+        int x = 0;
+        while (x < width) {
+            if (!match(row[x])) {
+                x++;
+                continue;
+            }
+            int start = x;
+            while (x < width && match(row[x])) x++;
+            spans.push_back({static_cast<int16_t>(y), static_cast<int16_t>(start),
+                             static_cast<int16_t>(x - 1)});
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#include "flush_planner.h"
+#include <algorithm>
+
+namespace {
+
+size_t pixelCount(int16_t x0, int16_t x1, int16_t y0, int16_t y1) {
+    return static_cast<size_t>(x1 - x0 + 1) * (y1 - y0 + 1);
+}
+
+} // namespace
+
+size_t FlushPlanner::plan(const uint16_t* source, const uint16_t* shadow, int stride, const Rectangle& rect,
+                          const PixelFormatInfo& format, const FlushCostModel& cost,
+                          std::vector<Rectangle>& windows) {
+    const size_t window_bytes = cost.windowBytes();
+    auto bytes = [&format](size_t pixels) { return format.packed_size(pixels); };
+    auto emit = [&windows](const Window& w) {
+        windows.push_back(Rectangle(w.x0, w.y0, w.x1 - w.x0 + 1, w.y1 - w.y0 + 1));
+    };
+
+    size_t changed = 0;
+    open.clear();
+    for (int16_t y = rect.y; y < rect.y + rect.height; y++) {
+        const uint16_t* src = source + y * stride;
+        const uint16_t* old = shadow + y * stride;
+
+        // участки строки, отличающиеся от панели; промежуток дешевле окна
+        // уходит вместе с соседними участками
+        runs.clear();
+        int16_t x = rect.x;
+        const int16_t end = rect.x + rect.width;
+        while (x < end) {
+            if (src[x] == old[x]) {
+                x++;
+                continue;
+            }
+            int16_t start = x;
+            while (x < end && src[x] != old[x]) x++;
+            changed += x - start;
+
+            Window run = {start, static_cast<int16_t>(x - 1), y, y};
+            if (!runs.empty()) {
+                Window& last = runs.back();
+                size_t merged = bytes(run.x1 - last.x0 + 1);
+                size_t separate = bytes(last.x1 - last.x0 + 1) + bytes(run.x1 - run.x0 + 1) + window_bytes;
+                if (merged <= separate) {
+                    last.x1 = run.x1;
+                    continue;
+                }
+            }
+            runs.push_back(run);
+        }
+
+        // участок растит окно, дошедшее до этой или предыдущей строки, если
+        // прирост дешевле отдельного окна; иначе начинает своё
+        next.clear();
+        for (const Window& run : runs) {
+            size_t separate = bytes(run.x1 - run.x0 + 1) + window_bytes;
+            Window* best = nullptr;
+            size_t best_delta = separate + 1;
+            for (std::vector<Window>* list : {&next, &open}) {
+                for (Window& w : *list) {
+                    // ушло в текущую строку
+                    if (w.y0 < 0) continue;
+                    int16_t x0 = std::min(w.x0, run.x0);
+                    int16_t x1 = std::max(w.x1, run.x1);
+                    size_t delta = bytes(pixelCount(x0, x1, w.y0, y)) - bytes(pixelCount(w.x0, w.x1, w.y0, w.y1));
+                    if (delta < best_delta) {
+                        best_delta = delta;
+                        best = &w;
+                    }
+                }
+            }
+
+            if (!best) {
+                next.push_back(run);
+                continue;
+            }
+            Window grown = {std::min(best->x0, run.x0), std::max(best->x1, run.x1), best->y0, y};
+            if (best >= open.data() && best < open.data() + open.size()) {
+                // окно переходит в текущую строку
+                best->y0 = -1;
+                next.push_back(grown);
+            } else {
+                *best = grown;
+            }
+        }
+
+        // окна, не получившие продолжения в этой строке, готовы
+        for (const Window& w : open) {
+            if (w.y0 >= 0) emit(w);
+        }
+        open.swap(next);
+    }
+
+    for (const Window& w : open) {
+        emit(w);
+    }
+    return changed;
+}
@@ -0,0 +1,244 @@
+#include "gif_decoder.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+uint16_t toRGB565(const GifColorType& color) {
+    return ((color.Red >> 3) << 11) | ((color.Green >> 2) << 5) | (color.Blue >> 3);
+}
+
+// порядок строк в чересстрочном кадре: четыре прохода
+const int INTERLACE_OFFSET[] = {0, 4, 2, 1};
+const int INTERLACE_STEP[] = {8, 8, 4, 2};
+
+} // namespace
+
+GifDecoder::GifDecoder()
+    : gif(nullptr), screen_width(0), screen_height(0), background_color(0),
+      ditherer(DitherMode::None), interlaced_ditherer(DitherMode::Bayer8),
+      frame_pending(false) {
+    std::memset(palette, 0, sizeof(palette));
+    std::memset(palette_bgr, 0, sizeof(palette_bgr));
+}
+
+GifDecoder::~GifDecoder() {
+    close();
+}
+
+bool GifDecoder::open(const std::string& filename) {
+    close();
+
+    int error = 0;
+    gif = DGifOpenFileName(filename.c_str(), &error);
+    if (!gif) {
+        std::cerr << "Failed to open GIF file: " << filename << " (" << GifErrorString(error) << ")" << std::endl;
+        return false;
+    }
+
+    path = filename;
+    screen_width = gif->SWidth;
+    screen_height = gif->SHeight;
+    buildPalette(gif->SColorMap);
+    background_color = gif->SColorMap ? palette[gif->SBackGroundColor & 0xFF] : 0;
+    frame_pending = false;
+    return true;
+}
+
+void GifDecoder::close() {
+    if (!gif) return;
+
+    int error = 0;
+    DGifCloseFile(gif, &error);
+    gif = nullptr;
+    frame_pending = false;
+}
+
+bool GifDecoder::rewind() {
+    std::string filename = path;
+    return open(filename);
+}
+
+void GifDecoder::setDither(DitherMode mode) {
+    ditherer = Ditherer(mode);
+}
+
+bool GifDecoder::nextFrame(Frame& frame) {
+    if (!gif) return false;
+
+    // данные предыдущего кадра не прочитаны - без этого поток записей не найти
+    if (frame_pending && !skipFrame()) {
+        return false;
+    }
+
+    Frame next;
+    GifRecordType record;
+    do {
+        if (DGifGetRecordType(gif, &record) == GIF_ERROR) {
+            reportError("Failed to read GIF record");
+            return false;
+        }
+
+        if (record == EXTENSION_RECORD_TYPE) {
+            int code = 0;
+            GifByteType* extension = nullptr;
+            if (DGifGetExtension(gif, &code, &extension) == GIF_ERROR) {
+                reportError("Failed to read GIF extension");
+                return false;
+            }
+            // задержка, прозрачность и способ очистки следующего кадра
+            if (code == GRAPHICS_EXT_FUNC_CODE && extension) {
+                GraphicsControlBlock gcb;
+                if (DGifExtensionToGCB(extension[0], extension + 1, &gcb) == GIF_OK) {
+                    next.delay_ms = static_cast<uint32_t>(gcb.DelayTime) * 10;
+                    next.disposal = gcb.DisposalMode;
+                    next.transparent_index = gcb.TransparentColor;
+                }
+            }
+            while (extension) {
+                if (DGifGetExtensionNext(gif, &extension) == GIF_ERROR) {
+                    reportError("Failed to read GIF extension");
+                    return false;
+                }
+            }
+        }
+    } while (record != IMAGE_DESC_RECORD_TYPE && record != TERMINATE_RECORD_TYPE);
+
+    if (record == TERMINATE_RECORD_TYPE) {
+        return false;
+    }
+
+    if (DGifGetImageDesc(gif) == GIF_ERROR) {
+        reportError("Failed to read GIF image descriptor");
+        return false;
+    }
+
+    const GifImageDesc& desc = gif->Image;
+    if (desc.Width <= 0 || desc.Height <= 0) {
+        std::cerr << "Invalid GIF frame size" << std::endl;
+        return false;
+    }
+
+    next.left = desc.Left;
+    next.top = desc.Top;
+    next.width = desc.Width;
+    next.height = desc.Height;
+    next.interlaced = desc.Interlace;
+
+    // локальная палитра действует только на этот кадр
+    buildPalette(desc.ColorMap ? desc.ColorMap : gif->SColorMap);
+
+    current = next;
+    frame = next;
+    frame_pending = true;
+    return true;
+}
+
+bool GifDecoder::decodeFrame(const RowHandler& handler) {
+    if (!gif || !frame_pending) return false;
+    frame_pending = false;
+
+    index_row.resize(current.width);
+    color_row.resize(current.width);
+
+    Ditherer* dither = nullptr;
+    if (ditherer.getMode() != DitherMode::None) {
+        dither = current.interlaced && ditherer.isErrorDiffusion() ? &interlaced_ditherer : &ditherer;
+        dither->begin(current.width, current.left);
+    }
+
+    int passes = current.interlaced ? 4 : 1;
+    for (int pass = 0; pass < passes; pass++) {
+        int first = current.interlaced ? INTERLACE_OFFSET[pass] : 0;
+        int step = current.interlaced ? INTERLACE_STEP[pass] : 1;
+
+        for (int row = first; row < current.height; row += step) {
+            if (DGifGetLine(gif, index_row.data(), current.width) == GIF_ERROR) {
+                reportError("Failed to decode GIF frame");
+                return false;
+            }
+            if (dither) {
+                dither->indexedRow(index_row.data(), palette_bgr, color_row.data(), current.top + row);
+            } else {
+                for (int x = 0; x < current.width; x++) {
+                    color_row[x] = palette[index_row[x]];
+                }
+            }
+            handler(current.top + row, index_row.data(), color_row.data());
+        }
+    }
+    return true;
+}
+
+bool GifDecoder::skipFrame() {
+    if (!gif || !frame_pending) return false;
+    frame_pending = false;
+
+    int code_size = 0;
+    GifByteType* block = nullptr;
+    if (DGifGetCode(gif, &code_size, &block) == GIF_ERROR) {
+        reportError("Failed to skip GIF frame");
+        return false;
+    }
+    while (block) {
+        if (DGifGetCodeNext(gif, &block) == GIF_ERROR) {
+            reportError("Failed to skip GIF frame");
+            return false;
+        }
+    }
+    return true;
+}
+
+void GifDecoder::buildPalette(const ColorMapObject* map) {
+    // индексы за пределами палитры дают чёрный
+    std::memset(palette, 0, sizeof(palette));
+    std::memset(palette_bgr, 0, sizeof(palette_bgr));
+    if (!map) return;
+
+    int count = map->ColorCount < 256 ? map->ColorCount : 256;
+    for (int i = 0; i < count; i++) {
+        palette[i] = toRGB565(map->Colors[i]);
+        palette_bgr[i * 3] = map->Colors[i].Blue;
+        palette_bgr[i * 3 + 1] = map->Colors[i].Green;
+        palette_bgr[i * 3 + 2] = map->Colors[i].Red;
+    }
+}
+
+void GifDecoder::reportError(const char* what) {
+    std::cerr << what << ": " << GifErrorString(gif->Error) << std::endl;
+}
+
+bool loadGIF(const std::string& filename, ImageData& imageData, DitherMode dither) {
+    GifDecoder decoder;
+    if (!decoder.open(filename)) {
+        return false;
+    }
+    decoder.setDither(dither);
+
+    GifDecoder::Frame frame;
+    if (!decoder.nextFrame(frame)) {
+        std::cerr << "No frames in GIF file" << std::endl;
+        return false;
+    }
+
+    // первый кадр может занимать только часть логического экрана
+    imageData.width = decoder.getWidth();
+    imageData.height = decoder.getHeight();
+    imageData.pixels.assign(imageData.width * imageData.height, decoder.getBackgroundColor());
+
+    int16_t x0 = std::max<int16_t>(frame.left, 0);
+    int16_t x1 = std::min<int16_t>(frame.left + frame.width, imageData.width);
+    return decoder.decodeFrame([&](int16_t y, const uint8_t* indices, const uint16_t* colors) {
+        if (y < 0 || y >= imageData.height) {
+            return;
+        }
+        uint16_t* row = &imageData.pixels[y * imageData.width];
+        for (int16_t x = x0; x < x1; x++) {
+            int i = x - frame.left;
+            if (indices[i] != frame.transparent_index) {
+                row[x] = colors[i];
+            }
+        }
+    });
+}
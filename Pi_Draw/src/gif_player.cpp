@@ -0,0 +1,199 @@
+#include "gif_player.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// за отставание больше этого кадры не догоняем, а начинаем отсчёт заново
+constexpr std::chrono::milliseconds RESYNC_LIMIT(1000);
+
+} // namespace
+
+GifPlayer::GifPlayer(TFTDisplay& display)
+    : display(display), origin_x(0), origin_y(0), playing(false), looping(true),
+      has_previous(false), pending_rect(0, 0, 0, 0), fps_window_frames(0), bytes_total(0) {
+}
+
+bool GifPlayer::open(const std::string& filename, int16_t x, int16_t y) {
+    stop();
+    if (!decoder.open(filename)) {
+        return false;
+    }
+
+    origin_x = x;
+    origin_y = y;
+    has_previous = false;
+    pending_rect = Rectangle(0, 0, 0, 0);
+    playing = true;
+    next_due = Clock::now();
+    resetStats();
+    return true;
+}
+
+void GifPlayer::stop() {
+    decoder.close();
+    playing = false;
+    saved_pixels.clear();
+    saved_pixels.shrink_to_fit();
+}
+
+void GifPlayer::resetStats() {
+    stats = GifPlaybackStats();
+    fps_window_start = Clock::now();
+    fps_window_frames = 0;
+    bytes_total = 0;
+}
+
+bool GifPlayer::update(Clock::time_point now) {
+    if (!playing || now < next_due) return false;
+
+    while (now >= next_due) {
+        uint32_t delay_ms = 0;
+        if (!composeNextFrame(delay_ms)) {
+            playing = false;
+            break;
+        }
+        next_due += std::chrono::milliseconds(delay_ms);
+
+        // время кадра ещё не вышло - показываем
+        if (now < next_due) {
+            display.present();
+            stats.frames_shown++;
+            fps_window_frames++;
+            if (pending_rect.width > 0) {
+                bytes_total += display.packedSize(static_cast<size_t>(pending_rect.width) * pending_rect.height) +
+                               WINDOW_OVERHEAD_BYTES;
+            }
+            stats.bytes_per_frame = static_cast<uint32_t>(bytes_total / stats.frames_shown);
+            pending_rect = Rectangle(0, 0, 0, 0);
+            break;
+        }
+
+        // кадр опоздал целиком: его изменения уйдут со следующим
+        stats.frames_dropped++;
+        if (now - next_due > RESYNC_LIMIT) {
+            next_due = now;
+        }
+    }
+
+    // анимация закончилась, а последний кадр ещё не отправлен
+    if (!playing && pending_rect.width > 0) {
+        display.present();
+        pending_rect = Rectangle(0, 0, 0, 0);
+    }
+
+    std::chrono::duration<float> elapsed = now - fps_window_start;
+    if (elapsed.count() >= 1.0f) {
+        stats.fps = fps_window_frames / elapsed.count();
+        fps_window_start = now;
+        fps_window_frames = 0;
+    }
+    return true;
+}
+
+bool GifPlayer::composeNextFrame(uint32_t& delay_ms) {
+    GifDecoder::Frame frame;
+    if (!decoder.nextFrame(frame)) {
+        if (!looping || !decoder.rewind() || !decoder.nextFrame(frame)) {
+            return false;
+        }
+    }
+
+    disposePrevious();
+
+    int16_t x0, y0, x1, y1;
+    bool visible = clipFrame(frame, x0, y0, x1, y1);
+    if (!visible) {
+        // кадр целиком за краем панели - распаковывать незачем
+        if (!decoder.skipFrame()) return false;
+    } else {
+        const uint16_t* framebuffer = display.getPixels();
+        int stride = display.getWidth();
+        int16_t w = x1 - x0;
+        int16_t h = y1 - y0;
+
+        // область под кадром понадобится для восстановления
+        if (frame.disposal == DISPOSE_PREVIOUS) {
+            saved_pixels.resize(static_cast<size_t>(w) * h);
+            for (int16_t row = 0; row < h; row++) {
+                std::memcpy(&saved_pixels[row * w], &framebuffer[(y0 + row) * stride + x0],
+                            w * sizeof(uint16_t));
+            }
+        }
+
+        // строки пишутся в кадровый буфер по мере распаковки; прозрачные
+        // пиксели оставляют то, что уже было на панели
+        row_buffer.resize(w);
+        int16_t source_x = x0 - origin_x - frame.left;
+        bool transparent = frame.transparent_index != NO_TRANSPARENT_COLOR;
+        bool ok = decoder.decodeFrame([&](int16_t y, const uint8_t* indices, const uint16_t* colors) {
+            int16_t py = origin_y + y;
+            if (py < y0 || py >= y1) return;
+
+            if (!transparent) {
+                display.blit(x0, py, w, 1, colors + source_x, w);
+                return;
+            }
+            std::memcpy(row_buffer.data(), &framebuffer[py * stride + x0], w * sizeof(uint16_t));
+            for (int16_t i = 0; i < w; i++) {
+                if (indices[source_x + i] != frame.transparent_index) {
+                    row_buffer[i] = colors[source_x + i];
+                }
+            }
+            display.blit(x0, py, w, 1, row_buffer.data(), w);
+        });
+        if (!ok) return false;
+
+        extendPending(Rectangle(x0, y0, w, h));
+    }
+
+    previous = frame;
+    has_previous = true;
+    delay_ms = frame.delay_ms < MIN_DELAY_MS ? DEFAULT_DELAY_MS : frame.delay_ms;
+    return true;
+}
+
+void GifPlayer::disposePrevious() {
+    if (!has_previous) return;
+    has_previous = false;
+
+    int16_t x0, y0, x1, y1;
+    if (!clipFrame(previous, x0, y0, x1, y1)) return;
+
+    switch (previous.disposal) {
+        case DISPOSE_BACKGROUND:
+            display.fillRect(x0, y0, x1 - x0, y1 - y0, decoder.getBackgroundColor());
+            break;
+        case DISPOSE_PREVIOUS:
+            if (saved_pixels.size() == static_cast<size_t>(x1 - x0) * (y1 - y0)) {
+                display.blit(x0, y0, x1 - x0, y1 - y0, saved_pixels.data(), x1 - x0);
+            }
+            break;
+        default:
+            return;
+    }
+    extendPending(Rectangle(x0, y0, x1 - x0, y1 - y0));
+}
+
+void GifPlayer::extendPending(const Rectangle& rect) {
+    if (pending_rect.width == 0) {
+        pending_rect = rect;
+        return;
+    }
+    int16_t x0 = std::min(pending_rect.x, rect.x);
+    int16_t y0 = std::min(pending_rect.y, rect.y);
+    int16_t x1 = std::max(pending_rect.x + pending_rect.width, rect.x + rect.width);
+    int16_t y1 = std::max(pending_rect.y + pending_rect.height, rect.y + rect.height);
+    pending_rect = Rectangle(x0, y0, x1 - x0, y1 - y0);
+}
+
+bool GifPlayer::clipFrame(const GifDecoder::Frame& frame, int16_t& x0, int16_t& y0,
+                          int16_t& x1, int16_t& y1) const {
+    int left = origin_x + frame.left;
+    int top = origin_y + frame.top;
+    x0 = std::max(left, 0);
+    y0 = std::max(top, 0);
+    x1 = std::min(left + frame.width, display.getWidth());
+    y1 = std::min(top + frame.height, display.getHeight());
+    return x0 < x1 && y0 < y1;
+}
@@ -0,0 +1,285 @@
+#include "image_cache.h"
+#include "asset565.h"
+#include "bmp_loader.h"
+#include "gif_decoder.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace {
+
+bool isImageFile(const std::string& filename) {
+    std::string ext = imageExtension(filename);
+    return ext == "bmp" || ext == "gif";
+}
+
+} // namespace
+
+std::string imageExtension(const std::string& filename) {
+    size_t dot = filename.find_last_of('.');
+    // точка в имени каталога - не расширение
+    if (dot == std::string::npos || filename.find('/', dot) != std::string::npos) return "";
+    std::string ext = filename.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+}
+
+void scaleImageToFit(ImageData& image, uint16_t max_width, uint16_t max_height) {
+    if (max_width == 0 || max_height == 0 || image.width == 0 || image.height == 0) return;
+
+    uint32_t width = max_width;
+    uint32_t height = static_cast<uint32_t>(image.height) * max_width / image.width;
+    if (height > max_height) {
+        height = max_height;
+        width = static_cast<uint32_t>(image.width) * max_height / image.height;
+    }
+    width = std::max<uint32_t>(width, 1);
+    height = std::max<uint32_t>(height, 1);
+    if (width == image.width && height == image.height) return;
+
+    std::vector<uint16_t> scaled(width * height);
+    // шаг по источнику в 16.16, без деления на каждый пиксель
+    uint32_t step_x = (static_cast<uint32_t>(image.width) << 16) / width;
+    uint32_t step_y = (static_cast<uint32_t>(image.height) << 16) / height;
+    for (uint32_t y = 0; y < height; y++) {
+        const uint16_t* src = &image.pixels[((y * step_y) >> 16) * image.width];
+        uint16_t* dst = &scaled[y * width];
+        uint32_t sx = 0;
+        for (uint32_t x = 0; x < width; x++, sx += step_x) {
+            dst[x] = src[sx >> 16];
+        }
+    }
+
+    image.pixels.swap(scaled);
+    image.width = width;
+    image.height = height;
+}
+
+bool loadImageFile(const std::string& filename, ImageData& image, DitherMode dither) {
+    std::string ext = imageExtension(filename);
+    if (ext == "bmp") {
+        return loadBMP(filename, image, dither);
+    }
+    if (ext == "gif") {
+        return loadGIF(filename, image, dither);
+    }
+    if (ext == "565") {
+        return loadAsset565(filename, image);
+    }
+    std::cerr << "Unsupported image format: " << filename << std::endl;
+    return false;
+}
+
+size_t ImageCache::KeyHash::operator()(const Key& key) const {
+    size_t h = std::hash<std::string>()(key.path);
+    h ^= std::hash<int64_t>()(key.mtime_ns) + 0x9E3779B9u + (h << 6) + (h >> 2);
+    uint32_t params = (static_cast<uint32_t>(key.max_width) << 16) ^ key.max_height ^
+                      (static_cast<uint32_t>(key.dither) << 29);
+    h ^= std::hash<uint32_t>()(params) + 0x9E3779B9u + (h << 6) + (h >> 2);
+    return h;
+}
+
+ImageCache::ImageCache(size_t budget_bytes)
+    : budget(budget_bytes), used_bytes(0), hits(0), misses(0), prefetch_running(false) {
+}
+
+ImageCache::~ImageCache() {
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        prefetch_running = false;
+        prefetch_queue.clear();
+    }
+    prefetch_cv.notify_one();
+    if (prefetch_thread.joinable()) {
+        prefetch_thread.join();
+    }
+}
+
+bool ImageCache::makeKey(const std::string& path, uint16_t max_width, uint16_t max_height,
+                         DitherMode dither, Key& key) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+
+    key.path = path;
+    key.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    key.max_width = max_width;
+    key.max_height = max_height;
+    key.dither = dither;
+    return true;
+}
+
+ImageCache::ImagePtr ImageCache::decode(const Key& key) {
+    auto image = std::make_shared<ImageData>();
+    if (!loadImageFile(key.path, *image, key.dither)) {
+        return nullptr;
+    }
+    scaleImageToFit(*image, key.max_width, key.max_height);
+    return image;
+}
+
+ImageCache::ImagePtr ImageCache::get(const std::string& path, uint16_t max_width, uint16_t max_height,
+                                     DitherMode dither) {
+    Key key;
+    if (!makeKey(path, max_width, max_height, dither, key)) {
+        std::cerr << "Image not found: " << path << std::endl;
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            hits++;
+            lru.splice(lru.begin(), lru, it->second.lru_position);
+            return it->second.image;
+        }
+        misses++;
+    }
+
+    // декодируем без блокировки: поток подгрузки может работать параллельно
+    ImagePtr image = decode(key);
+    if (!image) return nullptr;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    insert(key, image, true);
+    return image;
+}
+
+void ImageCache::prefetchSiblings(const std::string& path, uint16_t max_width, uint16_t max_height,
+                                  DitherMode dither) {
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : path.substr(0, slash);
+    std::string prefix = slash == std::string::npos ? "" : directory + "/";
+
+    std::vector<std::string> files;
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) return;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name[0] != '.' && isImageFile(name)) {
+            files.push_back(prefix + name);
+        }
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+
+    auto current = std::find(files.begin(), files.end(), path);
+    if (current == files.end()) return;
+    size_t index = current - files.begin();
+
+    // ближайшие соседи первыми: следующий, предыдущий, через один...
+    std::vector<Key> keys;
+    for (size_t d = 1; d <= PREFETCH_NEIGHBOURS; d++) {
+        Key key;
+        if (index + d < files.size() && makeKey(files[index + d], max_width, max_height, dither, key)) {
+            keys.push_back(key);
+        }
+        if (index >= d && makeKey(files[index - d], max_width, max_height, dither, key)) {
+            keys.push_back(key);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        prefetch_queue.clear();
+        for (const Key& key : keys) {
+            if (entries.find(key) == entries.end()) {
+                prefetch_queue.push_back(key);
+            }
+        }
+        if (prefetch_queue.empty()) return;
+
+        if (!prefetch_running) {
+            prefetch_running = true;
+            prefetch_thread = std::thread(&ImageCache::prefetchLoop, this);
+        }
+    }
+    prefetch_cv.notify_one();
+}
+
+void ImageCache::prefetchLoop() {
+    std::unique_lock<std::mutex> lock(cache_mutex);
+    while (true) {
+        prefetch_cv.wait(lock, [this] { return !prefetch_queue.empty() || !prefetch_running; });
+        if (!prefetch_running) break;
+
+        Key key = prefetch_queue.front();
+        prefetch_queue.pop_front();
+        if (entries.find(key) != entries.end()) continue;
+
+        lock.unlock();
+        ImagePtr image = decode(key);
+        lock.lock();
+
+        // подгруженное не вытесняет то, что уже выбирали: кладём в хвост
+        // и только если помещается в бюджет
+        if (image && entries.find(key) == entries.end() &&
+            used_bytes + image->pixels.size() * sizeof(uint16_t) <= budget) {
+            insert(key, image, false);
+        }
+    }
+}
+
+void ImageCache::insert(const Key& key, const ImagePtr& image, bool most_recent) {
+    auto existing = entries.find(key);
+    if (existing != entries.end()) {
+        used_bytes -= existing->second.bytes;
+        lru.erase(existing->second.lru_position);
+        entries.erase(existing);
+    }
+
+    Entry entry;
+    entry.image = image;
+    entry.bytes = image->pixels.size() * sizeof(uint16_t);
+    entry.lru_position = most_recent ? lru.insert(lru.begin(), key) : lru.insert(lru.end(), key);
+    used_bytes += entry.bytes;
+    entries.emplace(key, entry);
+    evict();
+}
+
+void ImageCache::evict() {
+    // последнее использованное остаётся, даже если больше бюджета;
+    // вытесненные изображения живут, пока на них есть указатели
+    while (used_bytes > budget && lru.size() > 1) {
+        auto it = entries.find(lru.back());
+        used_bytes -= it->second.bytes;
+        entries.erase(it);
+        lru.pop_back();
+    }
+}
+
+void ImageCache::setBudget(size_t budget_bytes) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    budget = budget_bytes;
+    evict();
+}
+
+size_t ImageCache::getBudget() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return budget;
+}
+
+size_t ImageCache::getUsedBytes() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return used_bytes;
+}
+
+size_t ImageCache::getHits() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return hits;
+}
+
+size_t ImageCache::getMisses() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return misses;
+}
+
+void ImageCache::clear() {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    entries.clear();
+    lru.clear();
+    used_bytes = 0;
+}
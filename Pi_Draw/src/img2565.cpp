@@ -0,0 +1,96 @@
+// Converts BMP/GIF images to the panel-native .565 format (see asset565.h)
+#include "asset565.h"
+#include "image_cache.h"
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] input.bmp|input.gif output.565\n"
+              << "  --size WxH       scale to fit, keeping the aspect ratio (default 160x128)\n"
+              << "  --original       keep the source size\n"
+              << "  --tile WxH       store the image in tiles\n"
+              << "  --rle            run-length encode the tiles\n"
+              << "  --little-endian  store pixels low byte first\n"
+              << "  --dither MODE    none|bayer4|bayer8|fs|atkinson (default fs)\n";
+}
+
+bool parseSize(const char* text, uint16_t& width, uint16_t& height) {
+    unsigned w = 0;
+    unsigned h = 0;
+    if (std::sscanf(text, "%ux%u", &w, &h) != 2 || w == 0 || h == 0 || w > 32767 || h > 32767) {
+        return false;
+    }
+    width = w;
+    height = h;
+    return true;
+}
+
+bool parseDither(const std::string& name, DitherMode& mode) {
+    if (name == "none") mode = DitherMode::None;
+    else if (name == "bayer4") mode = DitherMode::Bayer4;
+    else if (name == "bayer8") mode = DitherMode::Bayer8;
+    else if (name == "fs") mode = DitherMode::FloydSteinberg;
+    else if (name == "atkinson") mode = DitherMode::Atkinson;
+    else return false;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    // the app shows images on the panel rotated by 90 degrees
+    uint16_t maxWidth = 160;
+    uint16_t maxHeight = 128;
+    DitherMode dither = DitherMode::FloydSteinberg;
+    Asset565Options options;
+    std::string input;
+    std::string output;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--size" && hasValue && parseSize(argv[i + 1], maxWidth, maxHeight)) {
+            i++;
+        } else if (arg == "--original") {
+            maxWidth = maxHeight = 0;
+        } else if (arg == "--tile" && hasValue && parseSize(argv[i + 1], options.tile_width, options.tile_height)) {
+            i++;
+        } else if (arg == "--rle") {
+            options.rle = true;
+        } else if (arg == "--little-endian") {
+            options.big_endian = false;
+        } else if (arg == "--dither" && hasValue && parseDither(argv[i + 1], dither)) {
+            i++;
+        } else if (arg[0] != '-' && input.empty()) {
+            input = arg;
+        } else if (arg[0] != '-' && output.empty()) {
+            output = arg;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (input.empty() || output.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    ImageData image;
+    if (!loadImageFile(input, image, dither)) {
+        return 1;
+    }
+    scaleImageToFit(image, maxWidth, maxHeight);
+
+    if (!saveAsset565(output, image, options)) {
+        return 1;
+    }
+
+    std::cout << output << ": " << image.width << "x" << image.height
+              << (options.rle ? ", RLE" : "")
+              << (options.tile_width ? ", tiled" : "") << std::endl;
+    return 0;
+}
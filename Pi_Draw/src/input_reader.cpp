@@ -0,0 +1,374 @@
+#include "input_reader.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/input.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int MAX_EPOLL_EVENTS = 16;
+
+bool testBit(const unsigned long* bits, int bit) {
+    const int width = sizeof(unsigned long) * 8;
+    return (bits[bit / width] >> (bit % width)) & 1;
+}
+
+// устройство с относительными осями X/Y - мышь или тачпад в режиме мыши
+bool isPointer(int fd) {
+    const int width = sizeof(unsigned long) * 8;
+    unsigned long types[(EV_MAX + width) / width] = {};
+    unsigned long axes[(REL_MAX + width) / width] = {};
+    if (ioctl(fd, EVIOCGBIT(0, sizeof(types)), types) < 0) return false;
+    if (!testBit(types, EV_REL)) return false;
+    if (ioctl(fd, EVIOCGBIT(EV_REL, sizeof(axes)), axes) < 0) return false;
+    return testBit(axes, REL_X) && testBit(axes, REL_Y);
+}
+
+uint64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int16_t clampDelta(int value) {
+    return static_cast<int16_t>(std::max(-32768, std::min(32767, value)));
+}
+
+} // namespace
+
+InputReader::InputReader()
+    : epoll_fd(-1), wake_fd(-1), stop_fd(-1), inotify_fd(-1), dropped(0),
+      escape_state(0), escape_time_ms(0), wakeup_pending(false) {
+}
+
+InputReader::~InputReader() {
+    stop();
+}
+
+bool InputReader::start() {
+    if (thread.joinable()) return true;
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0 || stop_fd < 0) {
+        std::cerr << "Failed to create input epoll/eventfd: " << std::strerror(errno) << std::endl;
+        closeAll();
+        return false;
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = stop_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &event);
+
+    event.data.fd = STDIN_FILENO;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &event) < 0) {
+        std::cerr << "Terminal input unavailable: " << std::strerror(errno) << std::endl;
+    }
+    escape_state = 0;
+
+    // новые узлы event* появляются при подключении мыши; права на них udev
+    // выставляет чуть позже, отсюда IN_ATTRIB
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd >= 0 &&
+        inotify_add_watch(inotify_fd, "/dev/input", IN_CREATE | IN_ATTRIB) >= 0) {
+        event.data.fd = inotify_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, inotify_fd, &event);
+    } else {
+        std::cerr << "Mouse hotplug unavailable: " << std::strerror(errno) << std::endl;
+    }
+
+    openDevices();
+    if (devices.empty()) {
+        std::cerr << "Мышь не найдена\n";
+    }
+
+    thread = std::thread(&InputReader::run, this);
+    return true;
+}
+
+void InputReader::stop() {
+    if (thread.joinable()) {
+        uint64_t one = 1;
+        if (write(stop_fd, &one, sizeof(one)) != sizeof(one)) {
+            std::cerr << "Failed to signal input thread: " << std::strerror(errno) << std::endl;
+        }
+        thread.join();
+    }
+    closeAll();
+}
+
+void InputReader::clearWakeup() {
+    uint64_t count;
+    // EFD_NONBLOCK: без событий read вернёт EAGAIN
+    while (read(wake_fd, &count, sizeof(count)) < 0 && errno == EINTR) {
+    }
+}
+
+void InputReader::openDevices() {
+    DIR* dir = opendir("/dev/input");
+    if (!dir) return;
+
+    while (dirent* entry = readdir(dir)) {
+        openDevice(entry->d_name);
+    }
+    closedir(dir);
+}
+
+void InputReader::openDevice(const std::string& name) {
+    if (name.compare(0, 5, "event") != 0) return;
+
+    std::string path = "/dev/input/" + name;
+    for (const Device& device : devices) {
+        if (device.path == path) return;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return;
+    if (!isPointer(fd)) {
+        close(fd);
+        return;
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        close(fd);
+        return;
+    }
+    devices.push_back({fd, path, 0, 0, 0});
+}
+
+void InputReader::readHotplug() {
+    // inotify_event выровнен по int
+    alignas(inotify_event) char buffer[4096];
+
+    while (true) {
+        ssize_t n = read(inotify_fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+
+        for (ssize_t offset = 0; offset < n;) {
+            const inotify_event* ev = reinterpret_cast<const inotify_event*>(buffer + offset);
+            if (ev->len > 0) openDevice(ev->name);
+            offset += sizeof(inotify_event) + ev->len;
+        }
+    }
+}
+
+void InputReader::closeAll() {
+    for (const Device& device : devices) {
+        close(device.fd);
+    }
+    devices.clear();
+    for (int* fd : {&epoll_fd, &wake_fd, &stop_fd, &inotify_fd}) {
+        if (*fd >= 0) close(*fd);
+        *fd = -1;
+    }
+}
+
+void InputReader::run() {
+    epoll_event events[MAX_EPOLL_EVENTS];
+
+    while (true) {
+        // пока ESC ждёт продолжения, сон ограничен ESCAPE_TIMEOUT_MS
+        int timeout = -1;
+        if (escape_state != 0) {
+            uint64_t elapsed = nowMs() - escape_time_ms;
+            timeout = elapsed >= ESCAPE_TIMEOUT_MS ? 0 : static_cast<int>(ESCAPE_TIMEOUT_MS - elapsed);
+        }
+
+        int count = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, timeout);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Input epoll_wait failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        // продолжения не было - это отдельная клавиша ESC
+        if (count == 0) flushEscape();
+
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == stop_fd) return;
+
+            if (fd == STDIN_FILENO) {
+                // конец ввода: терминал больше не слушаем, иначе epoll не уснёт
+                if (!readTerminal()) {
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, STDIN_FILENO, nullptr);
+                }
+                continue;
+            }
+
+            if (fd == inotify_fd) {
+                readHotplug();
+                continue;
+            }
+
+            auto device = std::find_if(devices.begin(), devices.end(),
+                                       [fd](const Device& d) { return d.fd == fd; });
+            if (device == devices.end()) continue;
+            // устройство отключили
+            if (!readDevice(*device)) {
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+                close(fd);
+                devices.erase(device);
+            }
+        }
+
+        // один сигнал на всю пачку событий
+        if (wakeup_pending) {
+            wakeup_pending = false;
+            uint64_t one = 1;
+            if (write(wake_fd, &one, sizeof(one)) != sizeof(one)) {
+                std::cerr << "Failed to wake render loop: " << std::strerror(errno) << std::endl;
+            }
+        }
+    }
+}
+
+bool InputReader::readTerminal() {
+    char buffer[64];
+    ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+    if (n < 0) return errno == EINTR || errno == EAGAIN;
+    if (n == 0) return false;
+
+    for (ssize_t i = 0; i < n; i++) {
+        terminalByte(buffer[i]);
+    }
+    return true;
+}
+
+void InputReader::terminalByte(char byte) {
+    // ESC [ <параметры 0x30-0x3F> <последний байт>; из таких
+    // последовательностей нужны только стрелки ESC [ A..D
+    if (escape_state == 1) {
+        if (byte == '[') {
+            escape_state = 2;
+            return;
+        }
+        // одиночный ESC
+        escape_state = 0;
+        InputEvent event;
+        event.type = InputEventType::Key;
+        event.key = 27;
+        push(event);
+    } else if (escape_state == 2) {
+        if (byte >= 0x30 && byte <= 0x3F) return;
+        escape_state = 0;
+
+        InputEvent event;
+        event.type = InputEventType::Arrow;
+        switch (byte) {
+            case 'A': event.dy = -1; break;
+            case 'B': event.dy = 1; break;
+            case 'C': event.dx = 1; break;
+            case 'D': event.dx = -1; break;
+            default: return;
+        }
+        push(event);
+        return;
+    }
+
+    if (byte == 27) {
+        escape_state = 1;
+        escape_time_ms = nowMs();
+        return;
+    }
+    InputEvent event;
+    event.type = InputEventType::Key;
+    event.key = byte;
+    push(event);
+}
+
+void InputReader::flushEscape() {
+    // от незаконченной ESC [ ... остаётся только сам ESC
+    if (escape_state == 0) return;
+    escape_state = 0;
+
+    InputEvent event;
+    event.type = InputEventType::Key;
+    event.key = 27;
+    push(event);
+}
+
+bool InputReader::readDevice(Device& device) {
+    input_event buffer[64];
+
+    while (true) {
+        ssize_t n = read(device.fd, buffer, sizeof(buffer));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN;
+        }
+        if (n == 0) return false;
+
+        for (ssize_t i = 0; i < n / static_cast<ssize_t>(sizeof(input_event)); i++) {
+            const input_event& ev = buffer[i];
+            if (ev.type == EV_REL) {
+                if (ev.code == REL_X) device.dx += ev.value;
+                else if (ev.code == REL_Y) device.dy += ev.value;
+                else if (ev.code == REL_WHEEL) device.wheel += ev.value;
+            } else if (ev.type == EV_KEY && ev.value != 2) {
+                // автоповтор (value 2) кнопкам мыши не нужен
+                InputEvent event;
+                event.type = InputEventType::MouseButton;
+                event.pressed = ev.value != 0;
+                if (ev.code == BTN_LEFT) event.button = MouseButton::Left;
+                else if (ev.code == BTN_RIGHT) event.button = MouseButton::Right;
+                else if (ev.code == BTN_MIDDLE) event.button = MouseButton::Middle;
+                else continue;
+                // кнопка нажата в точке, куда мышь уже пришла
+                flushMotion(device);
+                push(event);
+            } else if (ev.type == EV_SYN) {
+                if (ev.code == SYN_REPORT) {
+                    flushMotion(device);
+                } else if (ev.code == SYN_DROPPED) {
+                    // ядро потеряло часть пакета - неполное смещение не применяем
+                    device.dx = device.dy = device.wheel = 0;
+                }
+            }
+        }
+    }
+}
+
+void InputReader::flushMotion(Device& device) {
+    if (device.dx != 0 || device.dy != 0) {
+        InputEvent event;
+        event.type = InputEventType::MouseMove;
+        event.dx = clampDelta(device.dx);
+        event.dy = clampDelta(device.dy);
+        push(event);
+    }
+    // по событию на каждый щелчок колеса
+    while (device.wheel != 0) {
+        InputEvent event;
+        event.type = InputEventType::MouseWheel;
+        event.dy = device.wheel > 0 ? 1 : -1;
+        device.wheel -= event.dy;
+        push(event);
+    }
+    device.dx = device.dy = 0;
+}
+
+void InputReader::push(InputEvent event) {
+    event.time_ms = nowMs();
+    if (!queue.push(event)) {
+        // читатель отстал на QUEUE_SIZE событий; ждать его здесь нельзя -
+        // тогда и stop() не дождётся потока
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    wakeup_pending = true;
+}
@@ -1,15 +1,51 @@
 #include "display_pi.h"
+#include "asset565.h"
 #include "tool_panel.h"
 #include "canvas.h"
+#include "gif_player.h"
+#include "image_cache.h"
+#include "perf_counters.h"
+#include "perf_overlay.h"
+#include "trace.h"
 #include <SFML/Graphics.hpp>
+#include <ctime>
+#include <fstream>
+#include <iostream>
 #include <string>
 
-int main() {
-    // Initialize display
-    TFTDisplay display;
+int main(int argc, char* argv[]) {
+    // --perf turns the counters on from the start, --perf-csv FILE also
+    // appends one row per second to FILE. F3 toggles the overlay.
+    // In builds with PI_DRAW_TRACE, F4 saves the recent trace spans
+    TRACE_THREAD_NAME("main");
+    PerfCounters perf;
+    std::ofstream perfCSV;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--perf") {
+            perf.setEnabled(true);
+        } else if (arg == "--perf-csv" && i + 1 < argc) {
+            perfCSV.open(argv[++i], std::ios::trunc);
+            if (!perfCSV) {
+                std::cerr << "Failed to open " << argv[i] << std::endl;
+                return 1;
+            }
+            PerfCounters::writeCSVHeader(perfCSV);
+            perf.setEnabled(true);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--perf] [--perf-csv FILE]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Initialize display; SPI transfers run on the display's flush thread.
+    // PixelFormat::RGB444 sends a quarter fewer bytes per frame at 12-bit colour
+    TFTDisplay display(0, 25, 24, 128, 160, FlushMode::Async, PixelFormat::RGB565);
+    display.setPerfCounters(&perf);
     display.init();
-    display.setRotation(1);
-    display.fillScreen(COLOR_WHITE);
+    display.setRotation(DisplayRotation::ROTATION_90);
+    display.clearScreen(COLOR_WHITE);
+    display.present();
 
     // Create window
     sf::RenderWindow window(sf::VideoMode(800, 600), "Drawing Application");
@@ -17,27 +53,102 @@ int main() {
 
     // Create tool panel and canvas
     ToolPanel toolPanel(sf::Vector2f(10, 10), sf::Vector2f(150, 580));
+    toolPanel.setImageTargetSize(display.getWidth(), display.getHeight());
     Canvas canvas(sf::Vector2f(170, 10), sf::Vector2f(620, 580), display);
     
     // Initialize drawing properties
     DrawingProperties props;
 
+    // Animated GIFs picked with the Image tool play on the panel
+    GifPlayer gifPlayer(display);
+    gifPlayer.setDither(DitherMode::Bayer4);
+    unsigned shownImageRevision = 0;
+    sf::Clock statsClock;
+    PerfOverlay perfOverlay(perf);
+
     while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed) {
-                window.close();
+        {
+            PerfScope scope(&perf, PerfTiming::Events);
+            TRACE_SCOPE("pollEvents");
+            sf::Event event;
+            while (window.pollEvent(event)) {
+                TRACE_INPUT_EVENT(event.type);
+                if (event.type == sf::Event::Closed) {
+                    window.close();
+                }
+                if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F3) {
+                    // showing the overlay starts the counters, hiding keeps them for the CSV
+                    perfOverlay.setVisible(!perfOverlay.isVisible());
+                    if (perfOverlay.isVisible()) perf.setEnabled(true);
+                }
+                if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F4) {
+                    if (!TRACE_ENABLED) {
+                        std::cerr << "Tracing is not built in, configure with -DPI_DRAW_TRACE=ON" << std::endl;
+                    } else {
+                        std::string traceFile = "trace_" + std::to_string(std::time(nullptr)) + ".json";
+                        if (saveTrace(traceFile)) {
+                            std::cout << "Trace saved to " << traceFile << std::endl;
+                        }
+                    }
+                }
+
+                toolPanel.handleEvent(event, props);
+                canvas.handleEvent(event, props);
+            }
+            // motion of this frame reaches the panel as one batch
+            canvas.commitInput(props);
+        }
+
+        if (props.imageRevision != shownImageRevision) {
+            shownImageRevision = props.imageRevision;
+            const std::string& path = props.imagePath;
+            // same case-insensitive check the image cache uses, so FOO.GIF animates too
+            const std::string ext = imageExtension(path);
+            if (ext == "gif") {
+                gifPlayer.open(path);
+            } else if (ext == "565") {
+                // pre-converted assets go to SPI from the mapped file, no decoding
+                gifPlayer.stop();
+                Asset565 asset;
+                if (asset.open(path)) {
+                    display.drawImage(0, 0, asset);
+                }
+            } else {
+                // still images come from the cache already scaled, one blit
+                gifPlayer.stop();
+                const ImageData& image = *props.backgroundImage;
+                display.blit(0, 0, image.width, image.height, image.pixels.data(), image.width);
+                display.present();
             }
-            
-            toolPanel.handleEvent(event, props);
-            canvas.handleEvent(event, props);
         }
 
-        window.clear(sf::Color(240, 240, 240));
-        
-        toolPanel.draw(window);
-        canvas.draw(window);
-        
+        if (gifPlayer.isPlaying()) {
+            gifPlayer.update();
+            if (statsClock.getElapsedTime().asSeconds() >= 1.0f) {
+                statsClock.restart();
+                const GifPlaybackStats& stats = gifPlayer.getStats();
+                std::cout << "GIF: " << stats.fps << " fps, "
+                          << stats.bytes_per_frame << " bytes/frame, "
+                          << stats.frames_dropped << " dropped" << std::endl;
+            }
+        }
+
+        if (perf.update() && perfCSV.is_open()) {
+            PerfCounters::writeCSVRow(perfCSV, perf.getLast());
+            perfCSV.flush();
+        }
+
+        {
+            // display() waits for the frame limit, so it stays outside the render time
+            PerfScope scope(&perf, PerfTiming::Render);
+            TRACE_SCOPE("render");
+            window.clear(sf::Color(240, 240, 240));
+
+            toolPanel.draw(window);
+            canvas.draw(window);
+            perfOverlay.draw(window);
+        }
+
         window.display();
     }
 
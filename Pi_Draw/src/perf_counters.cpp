@@ -0,0 +1,152 @@
+#include "perf_counters.h"
+#include <algorithm>
+#include <cmath>
+
+void PerfHistogram::record(uint64_t ns) {
+    buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    samples.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(ns, std::memory_order_relaxed);
+}
+
+uint64_t PerfHistogram::percentile(double p) const {
+    uint64_t n = count();
+    if (n == 0) return 0;
+
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p * n)));
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target) return bucketValue(i);
+    }
+    // счётчик samples обогнал корзины во время записи
+    return bucketValue(BUCKETS - 1);
+}
+
+void PerfHistogram::reset() {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    samples.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+}
+
+int PerfHistogram::bucketIndex(uint64_t ns) {
+    // до 4 нс - по корзине на значение, дальше октава старшего бита
+    // делится на SUB_BUCKETS частей по следующим двум битам
+    if (ns < SUB_BUCKETS) return static_cast<int>(ns);
+    int exponent = 63 - __builtin_clzll(ns);
+    int sub = (ns >> (exponent - 2)) & (SUB_BUCKETS - 1);
+    return exponent * SUB_BUCKETS + sub;
+}
+
+uint64_t PerfHistogram::bucketValue(int index) {
+    if (index < SUB_BUCKETS) return index;
+    int exponent = index / SUB_BUCKETS;
+    uint64_t width = 1ull << (exponent - 2);
+    uint64_t low = (SUB_BUCKETS + index % SUB_BUCKETS) * width;
+    return low + width / 2;
+}
+
+PerfCounters::PerfCounters(size_t max_history)
+    : enabled(false), interval_start_counters(), max_history(max_history) {
+    for (auto& counter : counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+}
+
+void PerfCounters::setEnabled(bool enabled) {
+    if (enabled == isEnabled()) return;
+    if (enabled) {
+        // новый отсчёт: интервалы до выключения в историю уже попали
+        for (size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+            interval_start_counters[i] = counters[i].load(std::memory_order_relaxed);
+        }
+        for (auto& histogram : histograms) {
+            histogram.reset();
+        }
+        interval_start = Clock::now();
+        if (history.empty()) enabled_at = interval_start;
+    }
+    this->enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool PerfCounters::update(Clock::duration interval) {
+    if (!isEnabled()) return false;
+
+    Clock::time_point now = Clock::now();
+    if (now - interval_start < interval) return false;
+
+    PerfSample sample;
+    sample.time_s = std::chrono::duration<double>(now - enabled_at).count();
+    sample.seconds = std::chrono::duration<double>(now - interval_start).count();
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        uint64_t value = counters[i].load(std::memory_order_relaxed);
+        sample.counters[i] = value - interval_start_counters[i];
+        interval_start_counters[i] = value;
+    }
+    for (size_t i = 0; i < PERF_TIMING_COUNT; i++) {
+        PerfHistogram& histogram = histograms[i];
+        PerfSample::Timing& timing = sample.timings[i];
+        timing.count = histogram.count();
+        timing.total_ns = histogram.total();
+        timing.p50_ns = histogram.percentile(0.50);
+        timing.p99_ns = histogram.percentile(0.99);
+        histogram.reset();
+    }
+    interval_start = now;
+
+    history.push_back(sample);
+    while (history.size() > max_history) {
+        history.pop_front();
+    }
+    return true;
+}
+
+const char* PerfCounters::name(PerfCounter counter) {
+    switch (counter) {
+        case PerfCounter::SpiBytes: return "spi_bytes";
+        case PerfCounter::SpiTransactions: return "spi_transactions";
+        case PerfCounter::DcToggles: return "dc_toggles";
+        case PerfCounter::WindowSetups: return "window_setups";
+        case PerfCounter::Flushes: return "flushes";
+        case PerfCounter::DiffSavedBytes: return "diff_saved_bytes";
+        case PerfCounter::Count: break;
+    }
+    return "unknown";
+}
+
+const char* PerfCounters::name(PerfTiming timing) {
+    switch (timing) {
+        case PerfTiming::SpiWrite: return "spi_write";
+        case PerfTiming::Events: return "events";
+        case PerfTiming::Render: return "render";
+        case PerfTiming::Flush: return "flush";
+        case PerfTiming::Count: break;
+    }
+    return "unknown";
+}
+
+void PerfCounters::writeCSVHeader(std::ostream& out) {
+    out << "time_s,seconds";
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        out << ',' << name(static_cast<PerfCounter>(i));
+    }
+    for (size_t i = 0; i < PERF_TIMING_COUNT; i++) {
+        const char* timing = name(static_cast<PerfTiming>(i));
+        out << ',' << timing << "_count," << timing << "_total_us,"
+            << timing << "_p50_us," << timing << "_p99_us";
+    }
+    out << '\n';
+}
+
+void PerfCounters::writeCSVRow(std::ostream& out, const PerfSample& sample) {
+    out << sample.time_s << ',' << sample.seconds;
+    for (uint64_t counter : sample.counters) {
+        out << ',' << counter;
+    }
+    for (const PerfSample::Timing& timing : sample.timings) {
+        out << ',' << timing.count << ',' << timing.total_ns / 1000.0
+            << ',' << timing.p50_ns / 1000.0 << ',' << timing.p99_ns / 1000.0;
+    }
+    out << '\n';
+}
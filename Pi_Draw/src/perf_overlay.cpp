@@ -0,0 +1,117 @@
+#include "perf_overlay.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+namespace {
+
+constexpr int PADDING = 3;
+
+std::string formatLine(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+std::string formatLine(const char* format, ...) {
+    char buffer[96];
+    va_list args;
+    va_start(args, format);
+    std::vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return buffer;
+}
+
+} // namespace
+
+PerfOverlay::PerfOverlay(const PerfCounters& perf)
+    : perf(perf), visible(false), shownKey(-3) {
+    texture.setSmooth(false);
+    background.setFillColor(sf::Color(0, 0, 0, 160));
+}
+
+std::vector<std::string> PerfOverlay::formatLines(const PerfSample& sample) const {
+    double seconds = std::max(sample.seconds, 1e-3);
+    auto perSecond = [&](PerfCounter counter) {
+        return static_cast<unsigned long long>(sample.counter(counter) / seconds + 0.5);
+    };
+    const PerfSample::Timing& spiWrite = sample.timing(PerfTiming::SpiWrite);
+
+    std::vector<std::string> lines;
+    lines.push_back(formatLine("SPI %7.1f KB/s %5llu txn/s",
+                               sample.counter(PerfCounter::SpiBytes) / seconds / 1024.0,
+                               perSecond(PerfCounter::SpiTransactions)));
+    lines.push_back(formatLine("DC %llu/s  WIN %llu/s  FLUSH %llu/s",
+                               perSecond(PerfCounter::DcToggles),
+                               perSecond(PerfCounter::WindowSetups),
+                               perSecond(PerfCounter::Flushes)));
+    lines.push_back(formatLine("SPI BUSY %3.0f%%  DIFF SAVED %.1f KB/s",
+                               spiWrite.total_ns / (seconds * 1e9) * 100.0,
+                               sample.counter(PerfCounter::DiffSavedBytes) / seconds / 1024.0));
+    lines.push_back("         N/s    p50us    p99us");
+    for (size_t i = 0; i < PERF_TIMING_COUNT; i++) {
+        const PerfSample::Timing& timing = sample.timings[i];
+        lines.push_back(formatLine("%-9s%4llu %8.1f %8.1f",
+                                   PerfCounters::name(static_cast<PerfTiming>(i)),
+                                   static_cast<unsigned long long>(timing.count / seconds + 0.5),
+                                   timing.p50_ns / 1000.0, timing.p99_ns / 1000.0));
+    }
+    return lines;
+}
+
+void PerfOverlay::renderText(const std::vector<std::string>& lines) {
+    const Font& font = FONT_5X7;
+    const int cellWidth = font.width + 1;
+    const int cellHeight = font.height + 2;
+
+    size_t columns = 0;
+    for (const std::string& line : lines) {
+        columns = std::max(columns, line.size());
+    }
+    unsigned int width = columns * cellWidth + PADDING * 2;
+    unsigned int height = lines.size() * cellHeight + PADDING * 2;
+
+    // white text on a transparent image, the background rectangle shades it
+    pixels.assign(static_cast<size_t>(width) * height * 4, 0);
+    for (size_t row = 0; row < lines.size(); row++) {
+        for (size_t column = 0; column < lines[row].size(); column++) {
+            const uint16_t* cell = glyphs.get(font, lines[row][column], 0xFFFF, 0x0000);
+            if (!cell) continue;
+            int x0 = PADDING + column * cellWidth;
+            int y0 = PADDING + row * cellHeight;
+            for (int y = 0; y < font.height; y++) {
+                for (int x = 0; x < font.width; x++) {
+                    if (cell[y * font.width + x] == 0) continue;
+                    sf::Uint8* out = &pixels[((y0 + y) * width + x0 + x) * 4];
+                    out[0] = out[1] = out[2] = out[3] = 255;
+                }
+            }
+        }
+    }
+
+    if (texture.getSize() != sf::Vector2u(width, height) && !texture.create(width, height)) {
+        return;
+    }
+    texture.update(pixels.data());
+    sprite.setTexture(texture, true);
+    sprite.setScale(SCALE, SCALE);
+    background.setSize(sf::Vector2f(width * SCALE, height * SCALE));
+}
+
+void PerfOverlay::draw(sf::RenderWindow& window) {
+    if (!visible) return;
+
+    // the latest sample time, or a negative marker for the placeholder text
+    double key = perf.hasSamples() ? perf.getLast().time_s : (perf.isEnabled() ? -1 : -2);
+    if (key != shownKey) {
+        shownKey = key;
+        if (perf.hasSamples()) {
+            renderText(formatLines(perf.getLast()));
+        } else {
+            renderText({perf.isEnabled() ? "collecting..." : "perf counters off"});
+        }
+    }
+
+    // top right corner, over the canvas
+    sf::Vector2f position(window.getSize().x - background.getSize().x - 10, 10);
+    background.setPosition(position);
+    sprite.setPosition(position);
+    window.draw(background);
+    window.draw(sprite);
+}
@@ -0,0 +1,195 @@
+#include "pixel_convert.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PIXEL_CONVERT_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXEL_CONVERT_SSE2 1
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define PIXEL_CONVERT_SSSE3 1
+#else
+#define PIXEL_CONVERT_SSSE3 0
+#endif
+#endif
+
+namespace pixel_convert {
+
+namespace {
+
+#if PIXEL_CONVERT_NEON
+// R, G, B в старших байтах 16-битных слов: вставка со сдвигом
+// собирает 5-6-5 без масок
+inline uint16x8_t pack565(uint8x8_t r, uint8x8_t g, uint8x8_t b) {
+    uint16x8_t out = vshll_n_u8(r, 8);
+    out = vsriq_n_u16(out, vshll_n_u8(g, 8), 5);
+    out = vsriq_n_u16(out, vshll_n_u8(b, 8), 11);
+    return out;
+}
+#endif
+
+#if PIXEL_CONVERT_SSE2
+// четыре пикселя B, G, R, X в 32-битных словах -> RGB565 в младших 16 битах
+inline __m128i pack565x4(__m128i p) {
+    __m128i r = _mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xF800));
+    __m128i g = _mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x07E0));
+    __m128i b = _mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0x001F));
+    __m128i v = _mm_or_si128(_mm_or_si128(r, g), b);
+    // packs работает со знаком: расширяем знак 16-го бита, чтобы 0xFFFF не насыщался
+    return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+#endif
+
+// сглаживание: канал сначала сжимается до v - v / 32 (v - v / 64 для зелёного),
+// чтобы после отбрасывания бит средний уровень был v * 31 / 255, а не v / 8,
+// затем к нему прибавляется порог из матрицы
+inline uint8_t ditherChannel(uint8_t value, uint8_t bias, int shift) {
+    int sum = value - (value >> shift) + bias;
+    return sum > 255 ? 255 : sum;
+}
+
+#if PIXEL_CONVERT_NEON
+inline uint8x16_t ditherChannel(uint8x16_t value, uint8x16_t bias, int shift) {
+    uint8x16_t scaled = shift == 5 ? vsubq_u8(value, vshrq_n_u8(value, 5))
+                                   : vsubq_u8(value, vshrq_n_u8(value, 6));
+    return vqaddq_u8(scaled, bias);
+}
+#endif
+
+#if PIXEL_CONVERT_SSE2
+// добавки в раскладке B, G, R, X для четырёх групп по 4 пикселя
+struct BiasLanes {
+    __m128i group[4];
+
+    explicit BiasLanes(const DitherBias& bias) {
+        alignas(16) uint8_t lanes[16];
+        for (int k = 0; k < 4; k++) {
+            for (int j = 0; j < 4; j++) {
+                lanes[j * 4] = bias.rb[k * 4 + j];
+                lanes[j * 4 + 1] = bias.g[k * 4 + j];
+                lanes[j * 4 + 2] = bias.rb[k * 4 + j];
+                lanes[j * 4 + 3] = 0;
+            }
+            group[k] = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes));
+        }
+    }
+};
+
+// побайтовых сдвигов в SSE нет: сдвигаем слова, маска оставляет
+// старшие биты того же байта
+inline __m128i ditherLanes(__m128i p, __m128i bias) {
+    const __m128i rb_mask = _mm_set1_epi32(0x00070007);
+    const __m128i g_mask = _mm_set1_epi32(0x00000300);
+    __m128i excess = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(p, 5), rb_mask),
+                                  _mm_and_si128(_mm_srli_epi16(p, 6), g_mask));
+    return _mm_adds_epu8(_mm_subs_epu8(p, excess), bias);
+}
+#endif
+
+template <int BPP, bool DITHER>
+void bgrToRGB565(const uint8_t* src, uint16_t* dst, size_t count, const DitherBias* bias) {
+    size_t i = 0;
+
+#if PIXEL_CONVERT_NEON
+    uint8x16_t rb_bias = vdupq_n_u8(0);
+    uint8x16_t g_bias = vdupq_n_u8(0);
+    if (DITHER) {
+        rb_bias = vld1q_u8(bias->rb);
+        g_bias = vld1q_u8(bias->g);
+    }
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t b, g, r;
+        if (BPP == 3) {
+            uint8x16x3_t bgr = vld3q_u8(src + i * 3);
+            b = bgr.val[0];
+            g = bgr.val[1];
+            r = bgr.val[2];
+        } else {
+            uint8x16x4_t bgrx = vld4q_u8(src + i * 4);
+            b = bgrx.val[0];
+            g = bgrx.val[1];
+            r = bgrx.val[2];
+        }
+        if (DITHER) {
+            b = ditherChannel(b, rb_bias, 5);
+            g = ditherChannel(g, g_bias, 6);
+            r = ditherChannel(r, rb_bias, 5);
+        }
+        vst1q_u16(dst + i, pack565(vget_low_u8(r), vget_low_u8(g), vget_low_u8(b)));
+        vst1q_u16(dst + i + 8, pack565(vget_high_u8(r), vget_high_u8(g), vget_high_u8(b)));
+    }
+#elif PIXEL_CONVERT_SSE2
+    if (BPP == 4 || PIXEL_CONVERT_SSSE3) {
+        BiasLanes lanes(DITHER ? *bias : DitherBias());
+        // 24 бита: 16-байтная загрузка читает 4 лишних байта, поэтому
+        // в конце строки оставляем запас в два пикселя
+        const size_t margin = BPP == 3 ? 2 : 0;
+        for (; i + 8 + margin <= count; i += 8) {
+            __m128i a = _mm_setzero_si128();
+            __m128i b = _mm_setzero_si128();
+            if (BPP == 3) {
+#if PIXEL_CONVERT_SSSE3
+                const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+                a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3)), spread);
+                b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 12)), spread);
+#endif
+            } else {
+                a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+                b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 16));
+            }
+            if (DITHER) {
+                int k = (i & 15) / 4;
+                a = ditherLanes(a, lanes.group[k]);
+                b = ditherLanes(b, lanes.group[k + 1]);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(pack565x4(a), pack565x4(b)));
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        const uint8_t* p = src + i * BPP;
+        if (DITHER) {
+            uint8_t rb = bias->rb[i & 15];
+            uint8_t g = bias->g[i & 15];
+            dst[i] = rgb565(ditherChannel(p[2], rb, 5), ditherChannel(p[1], g, 6), ditherChannel(p[0], rb, 5));
+        } else {
+            dst[i] = rgb565(p[2], p[1], p[0]);
+        }
+    }
+}
+
+} // namespace
+
+void bgr24ToRGB565(const uint8_t* src, uint16_t* dst, size_t count, const DitherBias* bias) {
+    if (bias) {
+        bgrToRGB565<3, true>(src, dst, count, bias);
+    } else {
+        bgrToRGB565<3, false>(src, dst, count, bias);
+    }
+}
+
+void bgrx32ToRGB565(const uint8_t* src, uint16_t* dst, size_t count, const DitherBias* bias) {
+    if (bias) {
+        bgrToRGB565<4, true>(src, dst, count, bias);
+    } else {
+        bgrToRGB565<4, false>(src, dst, count, bias);
+    }
+}
+
+void indexedToRGB565(const uint8_t* src, const uint16_t* lut, uint16_t* dst, size_t count) {
+    // выборка из таблицы векторизуется плохо, разворачиваем цикл
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        dst[i] = lut[src[i]];
+        dst[i + 1] = lut[src[i + 1]];
+        dst[i + 2] = lut[src[i + 2]];
+        dst[i + 3] = lut[src[i + 3]];
+    }
+    for (; i < count; i++) {
+        dst[i] = lut[src[i]];
+    }
+}
+
+} // namespace pixel_convert
@@ -0,0 +1,280 @@
+#include "raster.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+// полуширины эллипса по строкам: half[dy] - наибольший x с
+// x^2 * ry^2 + dy^2 * rx^2 <= rx^2 * ry^2 (строго меньше при strict),
+// для dy = 0..ry; -1, если в строке нет ни одного пикселя
+void ellipseHalfWidths(int32_t rx, int32_t ry, bool strict, std::vector<int16_t>& half) {
+    half.assign(ry + 1, -1);
+    int64_t rx2 = static_cast<int64_t>(rx) * rx;
+    int64_t ry2 = static_cast<int64_t>(ry) * ry;
+    int64_t limit = rx2 * ry2 - (strict ? 1 : 0);
+
+    // с ростом dy граница только сдвигается влево - обходимся без sqrt
+    int32_t x = rx;
+    for (int32_t dy = 0; dy <= ry; dy++) {
+        int64_t row = static_cast<int64_t>(dy) * dy * rx2;
+        while (x >= 0 && static_cast<int64_t>(x) * x * ry2 + row > limit) {
+            x--;
+        }
+        half[dy] = static_cast<int16_t>(x);
+    }
+}
+
+constexpr double EPSILON = 1e-6;
+
+// отрезок строки y внутри выпуклого многоугольника: [xl, xr]
+bool convexRow(const double* px, const double* py, int n, double y, double& xl, double& xr) {
+    bool found = false;
+    for (int i = 0; i < n; i++) {
+        int j = (i + 1) % n;
+        double ya = py[i], yb = py[j];
+        if ((y < std::min(ya, yb) - EPSILON) || (y > std::max(ya, yb) + EPSILON)) continue;
+
+        double xa = px[i], xb = px[j];
+        if (std::fabs(yb - ya) < EPSILON) {
+            // горизонтальное ребро целиком лежит на строке
+            xl = found ? std::min({xl, xa, xb}) : std::min(xa, xb);
+            xr = found ? std::max({xr, xa, xb}) : std::max(xa, xb);
+        } else {
+            double x = xa + (xb - xa) * (y - ya) / (yb - ya);
+            xl = found ? std::min(xl, x) : x;
+            xr = found ? std::max(xr, x) : x;
+        }
+        found = true;
+    }
+    return found;
+}
+
+// отрезок строки y внутри круга
+bool discRow(double cx, double cy, double r, double y, double& xl, double& xr) {
+    double dy = y - cy;
+    double d = r * r - dy * dy;
+    if (d < -EPSILON) return false;
+    double w = std::sqrt(std::max(d, 0.0));
+    xl = cx - w;
+    xr = cx + w;
+    return true;
+}
+
+// однопиксельная линия Брезенхема, собранная в горизонтальные отрезки
+void bresenhamSpans(int16_t x0, int16_t y0, int16_t x1, int16_t y1, std::vector<Span>& spans) {
+    int16_t dx = std::abs(x1 - x0);
+    int16_t dy = -std::abs(y1 - y0);
+    int16_t sx = x0 < x1 ? 1 : -1;
+    int16_t sy = y0 < y1 ? 1 : -1;
+    int16_t err = dx + dy;
+
+    Span run = {y0, x0, x0};
+    while (true) {
+        if (y0 != run.y) {
+            spans.push_back(run);
+            run = {y0, x0, x0};
+        } else {
+            run.x0 = std::min(run.x0, x0);
+            run.x1 = std::max(run.x1, x0);
+        }
+        if (x0 == x1 && y0 == y1) break;
+
+        int16_t e2 = 2 * err;
+        if (e2 >= dy) { err += dy; x0 += sx; }
+        if (e2 <= dx) { err += dx; y0 += sy; }
+    }
+    spans.push_back(run);
+}
+
+} // namespace
+
+namespace raster {
+
+void fillRect(int16_t x0, int16_t y0, int16_t x1, int16_t y1, std::vector<Span>& spans) {
+    if (x0 > x1) std::swap(x0, x1);
+    if (y0 > y1) std::swap(y0, y1);
+
+    for (int16_t y = y0; y <= y1; y++) {
+        spans.push_back({y, x0, x1});
+    }
+}
+
+void fillCircle(int16_t cx, int16_t cy, int16_t r, std::vector<Span>& spans) {
+    fillEllipse(cx, cy, r, r, spans);
+}
+
+void fillEllipse(int16_t cx, int16_t cy, int16_t rx, int16_t ry, std::vector<Span>& spans) {
+    if (rx < 0 || ry < 0) return;
+
+    std::vector<int16_t> half;
+    ellipseHalfWidths(rx, ry, false, half);
+
+    for (int16_t dy = -ry; dy <= ry; dy++) {
+        int16_t w = half[std::abs(dy)];
+        if (w < 0) continue;
+        spans.push_back({static_cast<int16_t>(cy + dy),
+                         static_cast<int16_t>(cx - w),
+                         static_cast<int16_t>(cx + w)});
+    }
+}
+
+void ellipseRing(int16_t cx, int16_t cy, int16_t rx, int16_t ry, int16_t width, std::vector<Span>& spans) {
+    if (rx < 0 || ry < 0) return;
+
+    int16_t irx = rx - width;
+    int16_t iry = ry - width;
+    if (width <= 0 || irx < 0 || iry < 0) {
+        fillEllipse(cx, cy, rx, ry, spans);
+        return;
+    }
+
+    std::vector<int16_t> outer;
+    std::vector<int16_t> inner;
+    ellipseHalfWidths(rx, ry, false, outer);
+    ellipseHalfWidths(irx, iry, true, inner);
+
+    for (int16_t dy = -ry; dy <= ry; dy++) {
+        int16_t y = cy + dy;
+        int16_t ow = outer[std::abs(dy)];
+        if (ow < 0) continue;
+
+        // выше и ниже внутреннего эллипса строка сплошная
+        int16_t iw = std::abs(dy) <= iry ? inner[std::abs(dy)] : -1;
+        if (iw < 0) {
+            spans.push_back({y, static_cast<int16_t>(cx - ow), static_cast<int16_t>(cx + ow)});
+            continue;
+        }
+
+        // иначе два отрезка слева и справа от внутренней области
+        if (iw >= ow) continue;
+        spans.push_back({y, static_cast<int16_t>(cx - ow), static_cast<int16_t>(cx - iw - 1)});
+        spans.push_back({y, static_cast<int16_t>(cx + iw + 1), static_cast<int16_t>(cx + ow)});
+    }
+}
+
+void strokeLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t width, LineCap cap,
+                std::vector<Span>& spans) {
+    if (width <= 1) {
+        bresenhamSpans(x0, y0, x1, y1, spans);
+        return;
+    }
+
+    // центры пикселей целые; при чётной толщине ось линии проходит по
+    // границе пикселей, иначе по центру - так толщина выходит ровно width
+    double shift = (width % 2 == 0) ? -0.5 : 0.0;
+    double ax = x0 + shift, ay = y0 + shift;
+    double bx = x1 + shift, by = y1 + shift;
+    double hw = width / 2.0;
+
+    double len = std::hypot(bx - ax, by - ay);
+    double ux = len > EPSILON ? (bx - ax) / len : 1.0;
+    double uy = len > EPSILON ? (by - ay) / len : 0.0;
+    double nx = -uy * hw, ny = ux * hw;
+
+    // тело линии - прямоугольник вдоль оси, для квадратного среза
+    // нулевой длины - квадрат со стороной width
+    double ex = 0.0, ey = 0.0;
+    if (len <= EPSILON && cap == LineCap::Butt) {
+        ex = hw;
+    }
+    double px[4] = {ax - ex + nx, bx + ex + nx, bx + ex - nx, ax - ex - nx};
+    double py[4] = {ay - ey + ny, by + ey + ny, by + ey - ny, ay - ey - ny};
+
+    double top = std::min({py[0], py[1], py[2], py[3]});
+    double bottom = std::max({py[0], py[1], py[2], py[3]});
+    if (cap == LineCap::Round) {
+        top = std::min(top, std::min(ay, by) - hw);
+        bottom = std::max(bottom, std::max(ay, by) + hw);
+    }
+
+    // капсула выпукла, поэтому в каждой строке ровно один отрезок
+    for (int y = static_cast<int>(std::ceil(top - EPSILON)); y <= static_cast<int>(std::floor(bottom + EPSILON)); y++) {
+        double xl = 0.0, xr = 0.0;
+        bool found = convexRow(px, py, 4, y, xl, xr);
+        if (cap == LineCap::Round) {
+            double cl, cr;
+            for (int end = 0; end < 2; end++) {
+                if (discRow(end ? bx : ax, end ? by : ay, hw, y, cl, cr)) {
+                    xl = found ? std::min(xl, cl) : cl;
+                    xr = found ? std::max(xr, cr) : cr;
+                    found = true;
+                }
+            }
+        }
+        if (!found) continue;
+
+        int16_t sx0 = static_cast<int16_t>(std::ceil(xl - EPSILON));
+        int16_t sx1 = static_cast<int16_t>(std::floor(xr + EPSILON));
+        if (sx0 <= sx1) {
+            spans.push_back({static_cast<int16_t>(y), sx0, sx1});
+        }
+    }
+}
+
+void strokeRect(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t width, std::vector<Span>& spans) {
+    if (x0 > x1) std::swap(x0, x1);
+    if (y0 > y1) std::swap(y0, y1);
+    if (width < 1) width = 1;
+
+    // рамка толще половины фигуры - это просто заливка
+    if (2 * width >= x1 - x0 + 1 || 2 * width >= y1 - y0 + 1) {
+        fillRect(x0, y0, x1, y1, spans);
+        return;
+    }
+
+    for (int16_t y = y0; y <= y1; y++) {
+        if (y < y0 + width || y > y1 - width) {
+            spans.push_back({y, x0, x1});
+        } else {
+            spans.push_back({y, x0, static_cast<int16_t>(x0 + width - 1)});
+            spans.push_back({y, static_cast<int16_t>(x1 - width + 1), x1});
+        }
+    }
+}
+
+void circleRing(int16_t cx, int16_t cy, int16_t r, uint8_t width, std::vector<Span>& spans) {
+    ellipseRing(cx, cy, r, r, width, spans);
+}
+
+void strokePolyline(const std::vector<Point>& points, uint8_t width, LineCap cap,
+                    std::vector<Span>& spans) {
+    if (points.empty()) return;
+    if (points.size() == 1) {
+        strokeLine(points[0].x, points[0].y, points[0].x, points[0].y, width, cap, spans);
+        normalizeSpans(spans);
+        return;
+    }
+
+    for (size_t i = 0; i + 1 < points.size(); i++) {
+        const Point& a = points[i];
+        const Point& b = points[i + 1];
+        strokeLine(a.x, a.y, b.x, b.y, width, cap, spans);
+        // у срезанных звеньев стык закрывает круг толщиной в линию
+        if (cap == LineCap::Butt && width > 1 && i > 0) {
+            strokeLine(a.x, a.y, a.x, a.y, width, LineCap::Round, spans);
+        }
+    }
+    normalizeSpans(spans);
+}
+
+void normalizeSpans(std::vector<Span>& spans) {
+    if (spans.empty()) return;
+
+    std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) {
+        return a.y != b.y ? a.y < b.y : a.x0 < b.x0;
+    });
+
+    size_t out = 0;
+    for (size_t i = 1; i < spans.size(); i++) {
+        Span& last = spans[out];
+        if (spans[i].y == last.y && spans[i].x0 <= last.x1 + 1) {
+            last.x1 = std::max(last.x1, spans[i].x1);
+        } else {
+            spans[++out] = spans[i];
+        }
+    }
+    spans.resize(out + 1);
+}
+
+} // namespace raster
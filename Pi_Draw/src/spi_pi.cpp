@@ -1,84 +1,113 @@
 #include "spi_pi.h"
+#include "trace.h"
 #include <stdexcept>
 #include <cstring>
 
-SPIDevice::SPIDevice(int channel, int speed) 
-    : spi_channel(channel), spi_speed(speed), spi_handle(-1),
-      chip(nullptr), dc_line(nullptr), rst_line(nullptr) {
+SPIDevice::SPIDevice(std::unique_ptr<SPIBackend> backend)
+    : backend(std::move(backend)), dc_state(-1), perf(nullptr) {
 }
 
-SPIDevice::~SPIDevice() {
-    if (spi_handle >= 0) {
-        spiClose(spi_handle);
-    }
-    if (dc_line) {
-        gpiod_line_release(dc_line);
-    }
-    if (rst_line) {
-        gpiod_line_release(rst_line);
+bool SPIDevice::init() {
+    dc_state = -1;
+    return backend->init();
+}
+
+void SPIDevice::write(const uint8_t* data, size_t length) {
+    TRACE_SCOPE_ARG("SPIDevice::write", "bytes", length);
+    bool written;
+    {
+        PerfScope scope(perf, PerfTiming::SpiWrite);
+        written = backend->write(data, length);
     }
-    if (chip) {
-        gpiod_chip_close(chip);
+    if (!written) {
+        throw std::runtime_error("SPI write failed");
     }
+    stats.spi_writes++;
+    stats.bytes += length;
+    if (perf) perf->add(PerfCounter::SpiBytes, length);
 }
 
-bool SPIDevice::init() {
-   
-    if (gpioInitialise() < 0) {
-        return false;
+void SPIDevice::submit(const SPITransaction& transaction) {
+    stats.segments += transaction.recorded;
+    stats.transactions++;
+    if (perf) perf->add(PerfCounter::SpiTransactions);
+    for (const auto& segment : transaction.segments) {
+        const uint8_t* data = segment.external
+            ? segment.external
+            : transaction.buffer.data() + segment.offset;
+        setDC(segment.dc);
+        write(data, segment.length);
     }
+}
 
-    // SPI
-    spi_handle = spiOpen(spi_channel, spi_speed, 0);
-    if (spi_handle < 0) {
-        return false;
+void SPIDevice::setDC(bool state) {
+    // линия уже в нужном состоянии - лишний системный вызов не нужен
+    if (dc_state == (state ? 1 : 0)) {
+        return;
     }
+    backend->setDC(state);
+    dc_state = state ? 1 : 0;
+    stats.dc_writes++;
+    if (perf) perf->add(PerfCounter::DcToggles);
+}
 
-    // GPIO 
-    chip = gpiod_chip_open("/dev/gpiochip0");
-    if (!chip) {
-        return false;
-    }
+void SPIDevice::setRST(bool state) {
+    backend->setRST(state);
+}
 
-    // 24 and 25 GPIO
-    dc_line = gpiod_chip_get_line(chip, 24);
-    rst_line = gpiod_chip_get_line(chip, 25);
-    
-    if (!dc_line || !rst_line) {
-        return false;
-    }
+void SPIDevice::delay(uint32_t ms) {
+    backend->delay(ms);
+}
 
+void SPITransaction::command(uint8_t cmd) {
+    append(false, &cmd, 1);
+}
 
-    if (gpiod_line_request_output(dc_line, "tft-dc", 0) < 0 ||
-        gpiod_line_request_output(rst_line, "tft-rst", 0) < 0) {
-        return false;
+void SPITransaction::command(uint8_t cmd, const uint8_t* params, size_t length) {
+    append(false, &cmd, 1);
+    if (length > 0) {
+        append(true, params, length);
     }
+}
 
-    return true;
+void SPITransaction::data(const uint8_t* data, size_t length) {
+    append(true, data, length);
 }
 
-void SPIDevice::write(uint8_t* data, size_t length) {
-    if (spi_handle < 0) {
-        throw std::runtime_error("SPI device not found");
-    }
-    
-    if (spiWrite(spi_handle, reinterpret_cast<char*>(data), length) < 0) {
-        throw std::runtime_error("SPI write failed");
+void SPITransaction::dataRef(const uint8_t* data, size_t length) {
+    if (length == 0) return;
+    recorded++;
+
+    // продолжение предыдущего внешнего блока в памяти - расширяем его
+    if (!segments.empty()) {
+        Segment& last = segments.back();
+        if (last.dc && last.external && last.external + last.length == data) {
+            last.length += length;
+            return;
+        }
     }
+    segments.push_back({true, data, 0, length});
 }
 
-void SPIDevice::setDC(bool state) {
-    if (dc_line) {
-        gpiod_line_set_value(dc_line, state ? 1 : 0);
-    }
+void SPITransaction::clear() {
+    buffer.clear();
+    segments.clear();
+    recorded = 0;
 }
 
-void SPIDevice::setRST(bool state) {
-    if (rst_line) {
-        gpiod_line_set_value(rst_line, state ? 1 : 0);
+void SPITransaction::append(bool dc, const uint8_t* data, size_t length) {
+    if (length == 0) return;
+    recorded++;
+
+    // тот же уровень DC и хвост внутреннего буфера - дописываем в сегмент
+    if (!segments.empty()) {
+        Segment& last = segments.back();
+        if (last.dc == dc && !last.external && last.offset + last.length == buffer.size()) {
+            buffer.insert(buffer.end(), data, data + length);
+            last.length += length;
+            return;
+        }
     }
+    segments.push_back({dc, nullptr, buffer.size(), length});
+    buffer.insert(buffer.end(), data, data + length);
 }
-
-void SPIDevice::delay(uint32_t ms) {
-    gpioDelay(ms * 1000);
-} 
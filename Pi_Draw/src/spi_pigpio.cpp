@@ -0,0 +1,99 @@
+#include "spi_pi.h"
+#include <gpiod.h>
+#include <pigpio.h>
+
+namespace {
+
+// SPI через pigpio, линии DC и RST через libgpiod
+class PigpioBackend : public SPIBackend {
+public:
+    PigpioBackend(int channel, int speed, int dc_pin, int rst_pin)
+        : spi_channel(channel), spi_speed(speed), dc_pin(dc_pin), rst_pin(rst_pin),
+          spi_handle(-1), chip(nullptr), dc_line(nullptr), rst_line(nullptr) {
+    }
+
+    ~PigpioBackend() override {
+        if (spi_handle >= 0) {
+            spiClose(spi_handle);
+        }
+        if (dc_line) {
+            gpiod_line_release(dc_line);
+        }
+        if (rst_line) {
+            gpiod_line_release(rst_line);
+        }
+        if (chip) {
+            gpiod_chip_close(chip);
+        }
+    }
+
+    bool init() override {
+        if (gpioInitialise() < 0) {
+            return false;
+        }
+
+        // SPI
+        spi_handle = spiOpen(spi_channel, spi_speed, 0);
+        if (spi_handle < 0) {
+            return false;
+        }
+
+        // GPIO
+        chip = gpiod_chip_open("/dev/gpiochip0");
+        if (!chip) {
+            return false;
+        }
+
+        dc_line = gpiod_chip_get_line(chip, dc_pin);
+        rst_line = gpiod_chip_get_line(chip, rst_pin);
+        if (!dc_line || !rst_line) {
+            return false;
+        }
+
+        if (gpiod_line_request_output(dc_line, "tft-dc", 0) < 0 ||
+            gpiod_line_request_output(rst_line, "tft-rst", 0) < 0) {
+            return false;
+        }
+
+        return true;
+    }
+
+    bool write(const uint8_t* data, size_t length) override {
+        if (spi_handle < 0) {
+            return false;
+        }
+        return spiWrite(spi_handle, reinterpret_cast<char*>(const_cast<uint8_t*>(data)), length) >= 0;
+    }
+
+    void setDC(bool state) override {
+        if (dc_line) {
+            gpiod_line_set_value(dc_line, state ? 1 : 0);
+        }
+    }
+
+    void setRST(bool state) override {
+        if (rst_line) {
+            gpiod_line_set_value(rst_line, state ? 1 : 0);
+        }
+    }
+
+    void delay(uint32_t ms) override {
+        gpioDelay(ms * 1000);
+    }
+
+private:
+    int spi_channel;
+    int spi_speed;
+    int dc_pin;
+    int rst_pin;
+    int spi_handle;
+    struct gpiod_chip* chip;
+    struct gpiod_line* dc_line;
+    struct gpiod_line* rst_line;
+};
+
+} // namespace
+
+std::unique_ptr<SPIBackend> makePigpioBackend(int channel, int speed, int dc_pin, int rst_pin) {
+    return std::unique_ptr<SPIBackend>(new PigpioBackend(channel, speed, dc_pin, rst_pin));
+}
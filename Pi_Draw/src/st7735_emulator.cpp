@@ -0,0 +1,429 @@
+#include "st7735_emulator.h"
+#include "commands.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr uint8_t MADCTL_MY = 0x80;
+constexpr uint8_t MADCTL_MX = 0x40;
+constexpr uint8_t MADCTL_MV = 0x20;
+constexpr uint8_t MADCTL_BGR = 0x08;
+
+constexpr uint8_t COLMOD_12BIT = 0x03;
+constexpr uint8_t COLMOD_16BIT = 0x05;
+constexpr uint8_t COLMOD_18BIT = 0x06;
+
+constexpr uint64_t MS = 1000000;
+// паузы по документации: после сброса и SLPOUT до следующей команды,
+// между сбросом и SLPOUT и между переключениями сна
+constexpr uint64_t COMMAND_WAIT_NS = 5 * MS;
+constexpr uint64_t SLEEP_WAIT_NS = 120 * MS;
+
+constexpr uint32_t WHITE = 0x3FFFF;
+
+// число параметров команды, -1 - команда неизвестна
+int paramCount(uint8_t cmd) {
+    switch (cmd) {
+        case CMD_NOP: case CMD_SWRESET: case CMD_RDDID: case CMD_RDDST:
+        case CMD_SLPIN: case CMD_SLPOUT: case CMD_PTLON: case CMD_NORON:
+        case CMD_INVOFF: case CMD_INVON: case CMD_DISPOFF: case CMD_DISPON:
+        case CMD_RAMWR: case CMD_RAMRD: case CMD_IDMOFF: case CMD_IDMON:
+            return 0;
+        case CMD_GAMSET: case CMD_MADCTL: case CMD_COLMOD: case CMD_INVCTR:
+        case CMD_PWCTR2: case CMD_VMCTR1: case CMD_VMOFCTR: case CMD_WRID2:
+        case CMD_WRID3: case CMD_NVCTR1:
+            return 1;
+        case CMD_VSCSAD: case CMD_DISSET5: case CMD_PWCTR3: case CMD_PWCTR4:
+        case CMD_PWCTR5:
+            return 2;
+        case CMD_FRMCTR1: case CMD_FRMCTR2: case CMD_PWCTR1:
+            return 3;
+        case CMD_CASET: case CMD_RASET: case CMD_PTLAR:
+            return 4;
+        case CMD_VSCRDEF: case CMD_FRMCTR3:
+            return 6;
+        case CMD_GAMCTRP1: case CMD_GAMCTRN1:
+            return 16;
+    }
+    return -1;
+}
+
+std::string hex(uint8_t value) {
+    char text[8];
+    std::snprintf(text, sizeof(text), "0x%02X", value);
+    return text;
+}
+
+uint16_t readU16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+// 5 бит канала в 6: младший бит повторяет старший, как в самой панели
+uint32_t expand5(uint32_t c) { return (c << 1) | (c >> 4); }
+uint32_t expand4(uint32_t c) { return (c << 2) | (c >> 2); }
+
+uint32_t pack666(uint32_t r, uint32_t g, uint32_t b) {
+    return (r << 12) | (g << 6) | b;
+}
+
+uint32_t from444(uint16_t c) {
+    return pack666(expand4((c >> 8) & 0x0F), expand4((c >> 4) & 0x0F), expand4(c & 0x0F));
+}
+
+uint32_t from565(uint16_t c) {
+    return pack666(expand5(c >> 11), (c >> 5) & 0x3F, expand5(c & 0x1F));
+}
+
+uint16_t to565(uint32_t c) {
+    return (((c >> 13) & 0x1F) << 11) | (((c >> 6) & 0x3F) << 5) | ((c >> 1) & 0x1F);
+}
+
+uint32_t to888(uint32_t c) {
+    uint32_t r = (c >> 12) & 0x3F;
+    uint32_t g = (c >> 6) & 0x3F;
+    uint32_t b = c & 0x3F;
+    return (((r << 2) | (r >> 4)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 2) | (b >> 4));
+}
+
+} // namespace
+
+ST7735Emulator::ST7735Emulator(uint32_t clock_hz, int width, int height)
+    : clock_hz(clock_hz), width(width), height(height), verbose(false),
+      gram(GRAM_WIDTH * GRAM_HEIGHT, 0),
+      dc(false), in_reset(false), now_ns(0) {
+    // включение питания - тот же аппаратный сброс
+    reset();
+}
+
+bool ST7735Emulator::init() {
+    return clock_hz > 0 && width > 0 && height > 0 &&
+           width <= GRAM_WIDTH && height <= GRAM_HEIGHT;
+}
+
+void ST7735Emulator::reset() {
+    // память после сброса не очищается
+    has_command = false;
+    param_count = param_expected = 0;
+    sleeping = true;
+    display_on = false;
+    inverted = false;
+    idle = false;
+    partial = false;
+    scrolling = false;
+    colmod = COLMOD_18BIT;
+    madctl = 0;
+    column_start = 0;
+    column_end = GRAM_WIDTH - 1;
+    row_start = 0;
+    row_end = GRAM_HEIGHT - 1;
+    partial_start = 0;
+    partial_end = GRAM_HEIGHT - 1;
+    scroll_top = 0;
+    scroll_height = GRAM_HEIGHT;
+    scroll_start = 0;
+    ram_write = false;
+    column = row = 0;
+    pixel_byte_count = 0;
+    ready_ns = now_ns + COMMAND_WAIT_NS;
+    sleep_ready_ns = now_ns + SLEEP_WAIT_NS;
+}
+
+void ST7735Emulator::setRST(bool state) {
+    // сброс срабатывает по отпусканию линии
+    if (!state) {
+        in_reset = true;
+    } else if (in_reset) {
+        in_reset = false;
+        reset();
+    }
+}
+
+void ST7735Emulator::delay(uint32_t ms) {
+    now_ns += ms * MS;
+    stats.delay_ns += ms * MS;
+}
+
+bool ST7735Emulator::write(const uint8_t* data, size_t length) {
+    uint64_t start = now_ns;
+    for (size_t i = 0; i < length; i++) {
+        // байт принят по окончании своих восьми тактов
+        now_ns = start + (i + 1) * 8 * 1000000000ull / clock_hz;
+        if (in_reset) continue;
+        if (dc) {
+            writeData(data[i]);
+        } else {
+            beginCommand(data[i]);
+        }
+    }
+    stats.bus_ns += now_ns - start;
+    return true;
+}
+
+void ST7735Emulator::beginCommand(uint8_t cmd) {
+    if (has_command && param_count < param_expected) {
+        protocolError("command " + hex(command) + " got " +
+                      std::to_string(param_count) + " of " + std::to_string(param_expected) + " parameters");
+    }
+    if (now_ns < ready_ns) {
+        stats.timing_violations++;
+        if (verbose) {
+            std::cerr << "ST7735 emulator: command " << hex(cmd) << " "
+                      << (ready_ns - now_ns) / 1000 << " us too early" << std::endl;
+        }
+    }
+
+    stats.commands++;
+    ram_write = false;
+    command = cmd;
+    param_count = 0;
+    int expected = paramCount(cmd);
+    if (expected < 0) {
+        // параметры неизвестной команды молча пропускаются
+        protocolError("unknown command " + hex(cmd));
+        has_command = false;
+        param_expected = 0;
+        return;
+    }
+    has_command = true;
+    param_expected = expected;
+    if (param_expected == 0) {
+        executeCommand();
+    }
+}
+
+void ST7735Emulator::writeData(uint8_t byte) {
+    if (ram_write) {
+        pixel_bytes[pixel_byte_count++] = byte;
+        if (colmod == COLMOD_16BIT) {
+            if (pixel_byte_count == 2) {
+                writePixel(from565(readU16(pixel_bytes)));
+                pixel_byte_count = 0;
+            }
+        } else if (colmod == COLMOD_12BIT) {
+            // два пикселя в трёх байтах, первый готов после второго байта
+            if (pixel_byte_count == 2) {
+                writePixel(from444((pixel_bytes[0] << 4) | (pixel_bytes[1] >> 4)));
+            } else if (pixel_byte_count == 3) {
+                writePixel(from444(((pixel_bytes[1] & 0x0F) << 8) | pixel_bytes[2]));
+                pixel_byte_count = 0;
+            }
+        } else if (pixel_byte_count == 3) {
+            writePixel(pack666(pixel_bytes[0] >> 2, pixel_bytes[1] >> 2, pixel_bytes[2] >> 2));
+            pixel_byte_count = 0;
+        }
+        return;
+    }
+
+    if (has_command && param_count < param_expected) {
+        params[param_count++] = byte;
+        if (param_count == param_expected) {
+            executeCommand();
+        }
+    } else if (has_command) {
+        protocolError("unexpected data after command " + hex(command));
+    }
+}
+
+void ST7735Emulator::executeCommand() {
+    switch (command) {
+        case CMD_SWRESET:
+            reset();
+            break;
+        case CMD_SLPIN:
+        case CMD_SLPOUT:
+            if (now_ns < sleep_ready_ns) {
+                stats.timing_violations++;
+                if (verbose) {
+                    std::cerr << "ST7735 emulator: sleep mode changed "
+                              << (sleep_ready_ns - now_ns) / 1000 << " us too early" << std::endl;
+                }
+            }
+            sleeping = command == CMD_SLPIN;
+            ready_ns = now_ns + COMMAND_WAIT_NS;
+            sleep_ready_ns = now_ns + SLEEP_WAIT_NS;
+            break;
+        case CMD_PTLON:
+            partial = true;
+            scrolling = false;
+            break;
+        case CMD_NORON:
+            partial = false;
+            scrolling = false;
+            break;
+        case CMD_INVOFF: inverted = false; break;
+        case CMD_INVON: inverted = true; break;
+        case CMD_DISPOFF: display_on = false; break;
+        case CMD_DISPON: display_on = true; break;
+        case CMD_IDMOFF: idle = false; break;
+        case CMD_IDMON: idle = true; break;
+        case CMD_CASET:
+            column_start = readU16(params);
+            column_end = readU16(params + 2);
+            break;
+        case CMD_RASET:
+            row_start = readU16(params);
+            row_end = readU16(params + 2);
+            break;
+        case CMD_RAMWR:
+            // запись всегда начинается с угла окна
+            ram_write = true;
+            column = column_start;
+            row = row_start;
+            pixel_byte_count = 0;
+            break;
+        case CMD_PTLAR:
+            partial_start = readU16(params);
+            partial_end = readU16(params + 2);
+            break;
+        case CMD_VSCRDEF: {
+            uint16_t top = readU16(params);
+            uint16_t lines = readU16(params + 2);
+            uint16_t bottom = readU16(params + 4);
+            if (top + lines + bottom != GRAM_HEIGHT) {
+                protocolError("VSCRDEF areas do not add up to " + std::to_string(GRAM_HEIGHT) + " lines");
+                break;
+            }
+            scroll_top = top;
+            scroll_height = lines;
+            break;
+        }
+        case CMD_VSCSAD:
+            scroll_start = readU16(params);
+            scrolling = true;
+            break;
+        case CMD_COLMOD: {
+            uint8_t mode = params[0] & 0x07;
+            if (mode != COLMOD_12BIT && mode != COLMOD_16BIT && mode != COLMOD_18BIT) {
+                protocolError("unsupported COLMOD " + hex(params[0]));
+                break;
+            }
+            colmod = mode;
+            break;
+        }
+        case CMD_MADCTL:
+            madctl = params[0];
+            break;
+        default:
+            // питание, гамма, частота кадров: на картинку не влияют
+            break;
+    }
+}
+
+bool ST7735Emulator::mapAddress(int column, int row, int& x, int& y) const {
+    x = (madctl & MADCTL_MV) ? row : column;
+    y = (madctl & MADCTL_MV) ? column : row;
+    if (madctl & MADCTL_MX) x = width - 1 - x;
+    if (madctl & MADCTL_MY) y = height - 1 - y;
+    return x >= 0 && x < GRAM_WIDTH && y >= 0 && y < GRAM_HEIGHT;
+}
+
+void ST7735Emulator::writePixel(uint32_t value) {
+    stats.pixels++;
+    int x, y;
+    if (mapAddress(column, row, x, y)) {
+        uint32_t& cell = gram[y * GRAM_WIDTH + x];
+        if (cell == value) stats.unchanged_pixels++;
+        cell = value;
+    } else {
+        stats.out_of_range_pixels++;
+    }
+
+    // счётчик идёт по строке окна, затем на следующую, после последней -
+    // снова в начало окна
+    if (++column > column_end) {
+        column = column_start;
+        if (++row > row_end) {
+            row = row_start;
+        }
+    }
+}
+
+void ST7735Emulator::protocolError(const std::string& message) {
+    stats.protocol_errors++;
+    if (verbose) {
+        std::cerr << "ST7735 emulator: " << message << std::endl;
+    }
+}
+
+int ST7735Emulator::displayLine(int y) const {
+    if (!scrolling || y < scroll_top || y >= scroll_top + scroll_height) {
+        return y;
+    }
+    int shift = (scroll_start - scroll_top) % scroll_height;
+    if (shift < 0) shift += scroll_height;
+    return scroll_top + (y - scroll_top + shift) % scroll_height;
+}
+
+uint32_t ST7735Emulator::shownPixel(int x, int y) const {
+    if (sleeping || !display_on) {
+        return WHITE;
+    }
+    if (partial) {
+        bool inside = partial_start <= partial_end
+            ? y >= partial_start && y <= partial_end
+            : y >= partial_start || y <= partial_end;
+        if (!inside) return WHITE;
+    }
+
+    uint32_t c = gram[displayLine(y) * GRAM_WIDTH + x];
+    if (idle) {
+        // восемь цветов: от канала остаётся старший бит
+        c = ((c & 0x20000) ? 0x3F000 : 0) | ((c & 0x800) ? 0xFC0 : 0) | ((c & 0x20) ? 0x3F : 0);
+    }
+    if (inverted) {
+        c ^= WHITE;
+    }
+    if (madctl & MADCTL_BGR) {
+        c = ((c & 0x3F) << 12) | (c & 0xFC0) | (c >> 12);
+    }
+    return c;
+}
+
+uint32_t ST7735Emulator::panelPixel(int x, int y) const {
+    if (x < 0 || x >= width || y < 0 || y >= height) return 0;
+    return to888(shownPixel(x, y));
+}
+
+uint32_t ST7735Emulator::gramPixel(int x, int y) const {
+    if (x < 0 || x >= GRAM_WIDTH || y < 0 || y >= GRAM_HEIGHT) return 0;
+    return to888(gram[y * GRAM_WIDTH + x]);
+}
+
+uint16_t ST7735Emulator::screenPixel565(int x, int y) const {
+    int px, py;
+    if (!mapAddress(x, y, px, py) || px >= width || py >= height) return 0;
+    return to565(shownPixel(px, py));
+}
+
+uint16_t ST7735Emulator::quantize565(uint16_t color, PixelFormat format) {
+    // RGB666 с повтором старших бит и RGB565 переживают запись без потерь
+    if (format != PixelFormat::RGB444) return color;
+    return to565(from444(RGB444Format::to444(color)));
+}
+
+bool ST7735Emulator::savePPM(const std::string& filename, EmulatorView view) const {
+    bool panel = view == EmulatorView::Panel;
+    int w = panel ? width : GRAM_WIDTH;
+    int h = panel ? height : GRAM_HEIGHT;
+
+    std::vector<uint8_t> pixels;
+    pixels.reserve(static_cast<size_t>(w) * h * 3);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            uint32_t c = panel ? panelPixel(x, y) : gramPixel(x, y);
+            pixels.push_back(c >> 16);
+            pixels.push_back((c >> 8) & 0xFF);
+            pixels.push_back(c & 0xFF);
+        }
+    }
+
+    std::ofstream stream(filename, std::ios::binary | std::ios::trunc);
+    stream << "P6\n" << w << " " << h << "\n255\n";
+    if (!stream.write(reinterpret_cast<const char*>(pixels.data()), pixels.size())) {
+        std::cerr << "Failed to write PPM file: " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,107 @@
+#include "text_console.h"
+#include <algorithm>
+
+TextConsole::TextConsole(TFTDisplay& display, int16_t top, int16_t rows)
+    : display(display), top(top), requested_rows(rows), rows(0), columns(0), line_height(0),
+      fg(COLOR_WHITE), bg(COLOR_BLACK), is_open(false) {
+}
+
+bool TextConsole::open() {
+    const Font& font = display.getFont();
+    if (font.width == 0 || font.height == 0) return false;
+
+    line_height = font.height + LINE_SPACING;
+    int16_t available = (display.getHeight() - top) / line_height;
+    rows = requested_rows > 0 ? std::min(requested_rows, available) : available;
+    columns = display.getWidth() / font.width;
+    if (top < 0 || rows <= 0 || columns <= 0) return false;
+
+    // без аппаратной прокрутки (повёрнутый экран) полоса перерисовывается
+    display.setScrollArea(top, rows * line_height);
+    is_open = true;
+    clear();
+    return true;
+}
+
+void TextConsole::close() {
+    if (!is_open) return;
+    display.clearScrollArea();
+    is_open = false;
+}
+
+void TextConsole::setColors(uint16_t fg, uint16_t bg) {
+    this->fg = fg;
+    this->bg = bg;
+}
+
+void TextConsole::print(const std::string& text) {
+    for (char c : text) {
+        putChar(c);
+    }
+}
+
+void TextConsole::putChar(char c) {
+    if (!is_open) return;
+
+    std::string& line = lines.back();
+    int16_t row = static_cast<int16_t>(lines.size()) - 1;
+    switch (c) {
+        case '\n':
+            newLine();
+            return;
+        case '\r':
+            // следующий вывод пишет строку заново
+            for (size_t i = 0; i < line.size(); i++) {
+                drawCell(row, i, ' ');
+            }
+            line.clear();
+            return;
+        case '\b':
+        case 127:
+            if (!line.empty()) {
+                line.pop_back();
+                drawCell(row, line.size(), ' ');
+            }
+            return;
+        case '\t':
+            do {
+                putChar(' ');
+            } while (lines.back().size() % TAB_WIDTH != 0);
+            return;
+        default:
+            break;
+    }
+
+    // строка заполнена - перенос
+    if (static_cast<int16_t>(line.size()) >= columns) {
+        newLine();
+        putChar(c);
+        return;
+    }
+
+    drawCell(row, line.size(), c);
+    line.push_back(c);
+}
+
+void TextConsole::clear() {
+    if (!is_open) return;
+    display.fillRect(0, top, display.getWidth(), rows * line_height, bg);
+    lines.assign(1, std::string());
+}
+
+void TextConsole::newLine() {
+    if (static_cast<int16_t>(lines.size()) < rows) {
+        lines.emplace_back();
+        return;
+    }
+
+    // полоса заполнена: сдвиг на строку, новая строка внизу уже залита фоном
+    display.scrollUp(line_height, bg);
+    lines.pop_front();
+    lines.emplace_back();
+}
+
+void TextConsole::drawCell(int16_t row, int16_t column, char c) {
+    const Font& font = display.getFont();
+    display.drawText(column * font.width, rowY(row), std::string(1, c), fg, bg);
+}
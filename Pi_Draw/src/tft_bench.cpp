@@ -0,0 +1,339 @@
+// Micro-benchmarks for the display primitives and Canvas tools. Everything
+// runs against an in-process SPI sink, so no panel is needed; the numbers
+// come from SPIDevice's counters and a wall clock. Results are JSON on stdout.
+// With --emulate the sink is replaced by the ST7735S emulator, which also
+// checks that the panel ends up showing the framebuffer.
+#include "canvas.h"
+#include "display_pi.h"
+#include "st7735_emulator.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct BenchOptions {
+    uint32_t clockHz = 8000000;
+    int iterations = 200;
+    PixelFormat format = PixelFormat::RGB565;
+    std::vector<int> sizes = {4, 16, 64, 128};
+    std::string filter;
+    // PPM file for the emulated panel, empty - plain sink
+    std::string emulateFile;
+    // compare dirty regions with what the panel shows and send changed windows
+    bool diffFlush = true;
+};
+
+struct BenchResult {
+    std::string name;
+    int size;
+    int iterations;
+    double wallNs;
+    SPIStats stats;
+    DiffFlushStats diff;
+    // only with the emulator
+    EmulatorStats emulated;
+    size_t mismatchedPixels = 0;
+};
+
+// one benchmark step: draws something of the given size, iteration varies the position
+using BenchStep = std::function<void(int size, int iteration)>;
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --clock HZ         SPI clock for the bus time estimate (default 8000000)\n"
+              << "  --iterations N     repetitions per primitive and size (default 200)\n"
+              << "  --sizes A,B,...    primitive sizes in pixels (default 4,16,64,128)\n"
+              << "  --format FMT       rgb444|rgb565|rgb666 (default rgb565)\n"
+              << "  --filter NAME      run only benchmarks whose name contains NAME\n"
+              << "  --emulate FILE     run against the ST7735S emulator, verify the panel\n"
+              << "                     contents after each benchmark and save them to FILE (PPM)\n"
+              << "  --diff on|off      send only the changed parts of dirty regions (default on)\n";
+}
+
+bool parseOptions(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--clock") {
+            options.clockHz = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--iterations") {
+            options.iterations = std::atoi(value.c_str());
+        } else if (arg == "--sizes") {
+            options.sizes.clear();
+            std::stringstream stream(value);
+            std::string item;
+            while (std::getline(stream, item, ',')) {
+                int size = std::atoi(item.c_str());
+                if (size > 0) options.sizes.push_back(size);
+            }
+        } else if (arg == "--format") {
+            if (value == "rgb444") options.format = PixelFormat::RGB444;
+            else if (value == "rgb565") options.format = PixelFormat::RGB565;
+            else if (value == "rgb666") options.format = PixelFormat::RGB666;
+            else return false;
+        } else if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--emulate") {
+            options.emulateFile = value;
+        } else if (arg == "--diff") {
+            if (value == "on") options.diffFlush = true;
+            else if (value == "off") options.diffFlush = false;
+            else return false;
+        } else {
+            return false;
+        }
+    }
+    return options.clockHz > 0 && options.iterations > 0 && !options.sizes.empty();
+}
+
+const char* formatName(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::RGB444: return "rgb444";
+        case PixelFormat::RGB565: return "rgb565";
+        case PixelFormat::RGB666: return "rgb666";
+    }
+    return "unknown";
+}
+
+// pixels where the emulated panel differs from the framebuffer, after the
+// same quantization the bus format applies
+size_t countMismatches(const TFTDisplay& display, const ST7735Emulator& emulator) {
+    const uint16_t* pixels = display.getPixels();
+    size_t mismatches = 0;
+    for (int y = 0; y < display.getHeight(); y++) {
+        for (int x = 0; x < display.getWidth(); x++) {
+            uint16_t expected = ST7735Emulator::quantize565(pixels[y * display.getWidth() + x],
+                                                            display.getPixelFormat());
+            if (emulator.screenPixel565(x, y) != expected) {
+                mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
+BenchResult runBench(TFTDisplay& display, ST7735Emulator* emulator, const std::string& name,
+                     int size, int iterations, const BenchStep& step) {
+    // warm up caches (glyphs, transfer buffers) outside the measurement
+    step(size, 0);
+    display.present();
+
+    display.resetSPIStats();
+    display.resetDiffFlushStats();
+    if (emulator) emulator->resetStats();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        step(size, i);
+        display.present();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    BenchResult result;
+    result.name = name;
+    result.size = size;
+    result.iterations = iterations;
+    result.wallNs = std::chrono::duration<double, std::nano>(elapsed).count();
+    result.stats = display.getSPIStats();
+    result.diff = display.getDiffFlushStats();
+    if (emulator) {
+        result.emulated = emulator->getStats();
+        result.mismatchedPixels = countMismatches(display, *emulator);
+    }
+    return result;
+}
+
+void printResult(const BenchResult& result, uint32_t clockHz, bool emulated, bool last) {
+    double n = result.iterations;
+    std::cout << "    {\"name\": \"" << result.name << "\", "
+              << "\"size\": " << result.size << ", "
+              << "\"iterations\": " << result.iterations << ", "
+              << "\"wall_ns_per_op\": " << result.wallNs / n << ", "
+              << "\"spi_bytes_per_op\": " << result.stats.bytes / n << ", "
+              << "\"transactions_per_op\": " << result.stats.transactions / n << ", "
+              << "\"spi_writes_per_op\": " << result.stats.spi_writes / n << ", "
+              << "\"dc_toggles_per_op\": " << result.stats.dc_writes / n << ", "
+              << "\"bus_us_per_op\": " << result.stats.busTimeUs(clockHz) / n << ", "
+              << "\"windows_per_op\": " << result.diff.windows / n << ", "
+              << "\"changed_pixels_per_op\": " << result.diff.changed_pixels / n << ", "
+              << "\"diff_saved_bytes_per_op\": " << result.diff.savedBytes() / n;
+    if (emulated) {
+        std::cout << ", \"pixels_per_op\": " << result.emulated.pixels / n
+                  << ", \"unchanged_pixels_per_op\": " << result.emulated.unchanged_pixels / n
+                  << ", \"out_of_range_pixels\": " << result.emulated.out_of_range_pixels
+                  << ", \"protocol_errors\": " << result.emulated.protocol_errors
+                  << ", \"mismatched_pixels\": " << result.mismatchedPixels;
+    }
+    std::cout << "}" << (last ? "\n" : ",\n");
+}
+
+sf::Event mouseButton(sf::Event::EventType type, int x, int y) {
+    sf::Event event;
+    event.type = type;
+    event.mouseButton.button = sf::Mouse::Left;
+    event.mouseButton.x = x;
+    event.mouseButton.y = y;
+    return event;
+}
+
+sf::Event mouseMove(int x, int y) {
+    sf::Event event;
+    event.type = sf::Event::MouseMoved;
+    event.mouseMove.x = x;
+    event.mouseMove.y = y;
+    return event;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // the display owns the backend, the emulator is kept for inspection
+    ST7735Emulator* emulator = nullptr;
+    std::unique_ptr<SPIBackend> backend;
+    if (options.emulateFile.empty()) {
+        backend.reset(new SPISink());
+    } else {
+        emulator = new ST7735Emulator(options.clockHz);
+        emulator->setVerbose(true);
+        backend.reset(emulator);
+    }
+    TFTDisplay display(std::move(backend), 128, 160, FlushMode::Sync, options.format);
+    display.setDiffFlush(options.diffFlush);
+    if (!display.init()) {
+        std::cerr << "Failed to initialise the display" << std::endl;
+        return 1;
+    }
+    const int width = display.getWidth();
+    const int height = display.getHeight();
+
+    // the canvas covers the panel 1:1, so window and panel coordinates match
+    Canvas canvas(sf::Vector2f(0, 0), sf::Vector2f(width, height), display);
+    DrawingProperties props;
+    props.lineWidth = 3;
+
+    std::vector<uint16_t> image(width * height);
+    for (size_t i = 0; i < image.size(); i++) {
+        image[i] = static_cast<uint16_t>(i * 2654435761u >> 16);
+    }
+
+    std::vector<uint16_t> block;
+
+    // positions wander over the panel so consecutive ops do not hit the same pixels
+    auto posX = [width](int size, int i) { return (i * 7) % std::max(1, width - size); };
+    auto posY = [height](int size, int i) { return (i * 13) % std::max(1, height - size); };
+    auto color = [](int i) { return static_cast<uint16_t>(i * 0x1234 + 1); };
+
+    auto canvasStroke = [&](Tool tool) {
+        return [&, tool](int size, int i) {
+            props.currentTool = tool;
+            int x = posX(size, i);
+            int y = posY(size, i);
+            canvas.handleEvent(mouseButton(sf::Event::MouseButtonPressed, x, y), props);
+            canvas.handleEvent(mouseMove(x + size / 2, y + size / 2), props);
+            canvas.handleEvent(mouseButton(sf::Event::MouseButtonReleased, x + size - 1, y + size - 1), props);
+        };
+    };
+
+    std::vector<std::pair<std::string, BenchStep>> benches = {
+        {"drawPixel", [&](int size, int i) {
+            // size pixels per op, then one present
+            for (int k = 0; k < size; k++) {
+                display.drawPixel((i + k * 5) % width, (i * 3 + k) % height, color(i + k));
+            }
+        }},
+        {"drawLine", [&](int size, int i) {
+            int x = posX(size, i);
+            int y = posY(size, i);
+            display.drawLine(x, y, x + size - 1, y + size / 2, color(i));
+        }},
+        {"drawRect", [&](int size, int i) {
+            display.drawRect(posX(size, i), posY(size, i), size, size, color(i));
+        }},
+        {"fillRect", [&](int size, int i) {
+            display.fillRect(posX(size, i), posY(size, i), size, size, color(i));
+        }},
+        {"drawCircle", [&](int size, int i) {
+            int r = size / 2;
+            display.drawCircle(posX(size, i) + r, posY(size, i) + r, r, color(i));
+        }},
+        {"fillCircle", [&](int size, int i) {
+            int r = size / 2;
+            display.fillCircle(posX(size, i) + r, posY(size, i) + r, r, color(i));
+        }},
+        {"drawText", [&](int size, int i) {
+            // size characters
+            display.drawText(0, posY(8, i), std::string(size, 'A' + i % 26), color(i));
+        }},
+        {"drawTextBg", [&](int size, int i) {
+            display.drawText(0, posY(8, i), std::string(size, 'A' + i % 26), color(i), 0);
+        }},
+        {"drawImage", [&](int size, int i) {
+            // size x size block cut out of the test image
+            int w = std::min(size, width);
+            int h = std::min(size, height);
+            if (block.size() != static_cast<size_t>(w * h)) {
+                block.resize(w * h);
+                for (int row = 0; row < h; row++) {
+                    std::memcpy(&block[row * w], &image[row * width], w * sizeof(uint16_t));
+                }
+            }
+            display.drawImage(posX(w, i), posY(h, i), w, h, block);
+        }},
+        {"canvasLine", canvasStroke(Tool::Line)},
+        {"canvasRect", canvasStroke(Tool::Rectangle)},
+        {"canvasCircle", canvasStroke(Tool::Circle)},
+        {"canvasEllipse", canvasStroke(Tool::Ellipse)},
+        {"canvasPencil", canvasStroke(Tool::Pencil)},
+        {"canvasFill", [&](int size, int i) {
+            // outline of size x size, then a click inside fills the (size - 2)^2 interior
+            int x = posX(size, i);
+            int y = posY(size, i);
+            display.drawRect(x, y, size, size, color(i));
+            props.currentTool = Tool::Fill;
+            props.color = color(i + 1);
+            canvas.handleEvent(mouseButton(sf::Event::MouseButtonPressed, x + size / 2, y + size / 2), props);
+            canvas.handleEvent(mouseButton(sf::Event::MouseButtonReleased, x + size / 2, y + size / 2), props);
+        }},
+    };
+
+    std::vector<BenchResult> results;
+    for (const auto& bench : benches) {
+        if (!options.filter.empty() && bench.first.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        for (int size : options.sizes) {
+            results.push_back(runBench(display, emulator, bench.first, size, options.iterations, bench.second));
+        }
+    }
+
+    std::cout << "{\n"
+              << "  \"clock_hz\": " << options.clockHz << ",\n"
+              << "  \"width\": " << width << ",\n"
+              << "  \"height\": " << height << ",\n"
+              << "  \"pixel_format\": \"" << formatName(options.format) << "\",\n"
+              << "  \"diff_flush\": " << (options.diffFlush ? "true" : "false") << ",\n"
+              << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        printResult(results[i], options.clockHz, emulator != nullptr, i + 1 == results.size());
+    }
+    std::cout << "  ]\n}" << std::endl;
+
+    if (emulator && !emulator->savePPM(options.emulateFile)) {
+        return 1;
+    }
+    return 0;
+}
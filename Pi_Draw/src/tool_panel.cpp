@@ -1,12 +1,13 @@
 #include "tool_panel.h"
 #include "file_dialog.h"
-#include <gif_lib.h>
+#include "image_cache.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <algorithm>
 
-ToolPanel::ToolPanel(const sf::Vector2f& position, const sf::Vector2f& size) {
+ToolPanel::ToolPanel(const sf::Vector2f& position, const sf::Vector2f& size)
+    : imageTargetWidth(0), imageTargetHeight(0) {
     panel.setPosition(position);
     panel.setSize(size);
     panel.setFillColor(sf::Color(240, 240, 240));
@@ -36,7 +37,10 @@ void ToolPanel::initializeButtons() {
         {Tool::Line, "Line"},
         {Tool::Rectangle, "Rect"},
         {Tool::Circle, "Circle"},
+        {Tool::Ellipse, "Ellipse"},
         {Tool::Eraser, "Eraser"},
+        {Tool::Fill, "Fill"},
+        {Tool::Background, "Bg"},
         {Tool::Image, "Image"}
     };
 
@@ -94,57 +98,62 @@ void ToolPanel::draw(sf::RenderWindow& window) {
     window.draw(lineWidthSlider);
 }
 
-bool ToolPanel::loadGIF(const std::string& filename, ImageData& imageData) {
-    int error = 0;
-    GifFileType* gif = DGifOpenFileName(filename.c_str(), &error);
-    
-    if (!gif) {
-        std::cerr << "Failed to open GIF file: " << filename << std::endl;
-        return false;
-    }
-
-    if (DGifSlurp(gif) != GIF_OK) {
-        std::cerr << "Failed to read GIF file" << std::endl;
-        DGifCloseFile(gif, &error);
-        return false;
+bool ToolPanel::loadImage(const std::string& filename, DrawingProperties& props) {
+    // .565 assets are already in panel format, main streams them straight from the file
+    if (imageExtension(filename) == "565") {
+        props.backgroundImage.reset();
+        props.hasBackgroundImage = true;
+        props.imagePath = filename;
+        props.imageRevision++;
+        return true;
     }
 
-    // Get dimensions
-    imageData.width = gif->SWidth;
-    imageData.height = gif->SHeight;
-    imageData.pixels.resize(imageData.width * imageData.height);
-
-    // Get color map
-    ColorMapObject* colorMap = gif->SColorMap;
-    if (!colorMap) {
-        std::cerr << "No color map in GIF" << std::endl;
-        DGifCloseFile(gif, &error);
+    // repeated picks of the same file are a cache lookup, no decode
+    ImageCache::ImagePtr image = imageCache.get(filename, imageTargetWidth, imageTargetHeight, props.ditherMode);
+    if (!image) {
         return false;
     }
 
-    // Process first frame
-    SavedImage* frame = &gif->SavedImages[0];
-    GifByteType* raster = frame->RasterBits;
+    props.backgroundImage = image;
+    props.hasBackgroundImage = true;
+    props.imagePath = filename;
+    props.imageRevision++;
 
-    for (int y = 0; y < imageData.height; y++) {
-        for (int x = 0; x < imageData.width; x++) {
-            int index = raster[y * imageData.width + x];
-            GifColorType color = colorMap->Colors[index];
+    // the next/previous files in the folder are likely picks, decode them in the background
+    imageCache.prefetchSiblings(filename, imageTargetWidth, imageTargetHeight, props.ditherMode);
+    return true;
+}
 
-            // Convert to RGB565
-            uint16_t rgb565 = ((color.Red >> 3) << 11) |
-                             ((color.Green >> 2) << 5) |
-                             (color.Blue >> 3);
+void ToolPanel::setImageTargetSize(uint16_t width, uint16_t height) {
+    imageTargetWidth = width;
+    imageTargetHeight = height;
+}
 
-            imageData.pixels[y * imageData.width + x] = rgb565;
+void ToolPanel::handleEvent(const sf::Event& event, DrawingProperties& props) {
+    // fill settings: [ and ] change the tolerance, 4 and 8 the connectivity
+    if (event.type == sf::Event::KeyPressed) {
+        switch (event.key.code) {
+            case sf::Keyboard::LBracket:
+                props.fillTolerance = std::max(0, props.fillTolerance - FILL_TOLERANCE_STEP);
+                break;
+            case sf::Keyboard::RBracket:
+                props.fillTolerance = std::min(255, props.fillTolerance + FILL_TOLERANCE_STEP);
+                break;
+            case sf::Keyboard::Num4:
+                props.fillConnectivity = FillConnectivity::Four;
+                break;
+            case sf::Keyboard::Num8:
+                props.fillConnectivity = FillConnectivity::Eight;
+                break;
+            default:
+                return;
         }
+        std::cout << "Fill: tolerance " << static_cast<int>(props.fillTolerance) << ", "
+                  << (props.fillConnectivity == FillConnectivity::Eight ? 8 : 4)
+                  << "-connected" << std::endl;
+        return;
     }
 
-    DGifCloseFile(gif, &error);
-    return true;
-}
-
-void ToolPanel::handleEvent(const sf::Event& event, DrawingProperties& props) {
     if (event.type == sf::Event::MouseButtonPressed) {
         sf::Vector2f mousePos(event.mouseButton.x, event.mouseButton.y);
         
@@ -154,7 +163,7 @@ void ToolPanel::handleEvent(const sf::Event& event, DrawingProperties& props) {
                 props.currentTool = button.tool;
                 if (button.tool == Tool::Image) {
                     // Show file dialog
-                    std::vector<std::string> filters = {"*.bmp", "*.gif"};
+                    std::vector<std::string> filters = {"*.bmp", "*.gif", "*.565"};
                     std::string filename = FileDialog::showOpenDialog(
                         "Select Image",
                         "/home/pi/Pictures",
@@ -162,9 +171,7 @@ void ToolPanel::handleEvent(const sf::Event& event, DrawingProperties& props) {
                     );
 
                     if (!filename.empty()) {
-                        if (loadGIF(filename, props.imageData)) {
-                            props.hasBackgroundImage = true;
-                        } else {
+                        if (!loadImage(filename, props)) {
                             std::cerr << "Failed to load image: " << filename << std::endl;
                         }
                     }
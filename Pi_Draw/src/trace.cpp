@@ -0,0 +1,237 @@
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// записей на поток: при десятках отрезков на событие - последние секунды работы
+constexpr size_t BUFFER_RECORDS = 32768;
+// стрелок от событий к одной выгрузке
+constexpr uint64_t MAX_FLOWS = 64;
+
+struct TraceRecord {
+    const char* name;
+    const char* arg_name;
+    uint64_t arg;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t event;
+    // у выгрузки - первое событие кадра и время его получения
+    uint64_t first_event;
+    uint64_t first_event_ns;
+    char phase; // 'X' - отрезок, 's' - начало стрелки
+};
+
+// кольцевой буфер пишет только свой поток, под мьютексом буфера: без
+// соперника захват стоит пары атомарных операций. saveTrace() держит его,
+// пока копирует записи, и не видит запись посреди изменения
+struct ThreadBuffer {
+    uint32_t tid = 0;
+    std::mutex mutex;
+    const char* name = nullptr;
+    std::vector<TraceRecord> records;
+    uint64_t written = 0;
+};
+
+std::mutex registry_mutex;
+// буферы остаются после завершения потока, чтобы его отрезки попали в файл
+std::vector<std::shared_ptr<ThreadBuffer>> registry;
+std::atomic<uint64_t> event_counter{0};
+
+thread_local std::shared_ptr<ThreadBuffer> local_buffer;
+thread_local uint64_t current_event = 0;
+thread_local uint64_t current_event_ns = 0;
+
+ThreadBuffer& threadBuffer() {
+    if (!local_buffer) {
+        auto buffer = std::make_shared<ThreadBuffer>();
+        buffer->records.resize(BUFFER_RECORDS);
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        buffer->tid = registry.size() + 1;
+        registry.push_back(buffer);
+        local_buffer = buffer;
+    }
+    return *local_buffer;
+}
+
+void push(const TraceRecord& record) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.records[buffer.written % BUFFER_RECORDS] = record;
+    buffer.written++;
+}
+
+void writeJSONString(FILE* out, const char* text) {
+    std::fputc('"', out);
+    for (const char* p = text; *p; p++) {
+        if (*p == '"' || *p == '\\') std::fputc('\\', out);
+        std::fputc(*p, out);
+    }
+    std::fputc('"', out);
+}
+
+void writeRecord(FILE* out, const TraceRecord& record, uint32_t tid, bool& first) {
+    double ts = record.start_ns / 1000.0;
+    if (record.phase == 's') {
+        std::fprintf(out, "%s\n{\"ph\":\"s\",\"name\":\"input\",\"cat\":\"input\",\"id\":%llu,"
+                     "\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+                     first ? "" : ",", static_cast<unsigned long long>(record.event), tid, ts);
+        first = false;
+        return;
+    }
+
+    std::fprintf(out, "%s\n{\"ph\":\"X\",\"name\":", first ? "" : ",");
+    first = false;
+    writeJSONString(out, record.name);
+    std::fprintf(out, ",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"event\":%llu",
+                 tid, ts, (record.end_ns - record.start_ns) / 1000.0,
+                 static_cast<unsigned long long>(record.event));
+    if (record.arg_name) {
+        std::fputc(',', out);
+        writeJSONString(out, record.arg_name);
+        std::fprintf(out, ":%llu", static_cast<unsigned long long>(record.arg));
+    }
+    if (record.first_event) {
+        std::fprintf(out, ",\"first_event\":%llu,\"input_to_flush_us\":%.3f",
+                     static_cast<unsigned long long>(record.first_event),
+                     (record.end_ns - record.first_event_ns) / 1000.0);
+    }
+    std::fputs("}}", out);
+
+    // стрелки от событий кадра заканчиваются на этой выгрузке
+    if (record.first_event) {
+        uint64_t from = std::max(record.first_event, record.event >= MAX_FLOWS ? record.event - MAX_FLOWS + 1 : 1);
+        for (uint64_t event = from; event <= record.event; event++) {
+            std::fprintf(out, ",\n{\"ph\":\"f\",\"bp\":\"e\",\"name\":\"input\",\"cat\":\"input\","
+                         "\"id\":%llu,\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+                         static_cast<unsigned long long>(event), tid, ts);
+        }
+    }
+}
+
+} // namespace
+
+void TraceEventRange::add(uint64_t event, uint64_t event_ns) {
+    if (event == 0) return;
+    if (first == 0) {
+        first = event;
+        first_ns = event_ns;
+    }
+    last = std::max(last, event);
+}
+
+uint64_t traceNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t traceBeginEvent() {
+    uint64_t event = ++event_counter;
+    TraceRecord record = {};
+    record.phase = 's';
+    record.start_ns = traceNow();
+    record.event = event;
+    push(record);
+    return event;
+}
+
+void traceSetEvent(uint64_t event, uint64_t event_ns) {
+    current_event = event;
+    current_event_ns = event_ns;
+}
+
+uint64_t traceCurrentEvent() {
+    return current_event;
+}
+
+uint64_t traceCurrentEventTime() {
+    return current_event_ns;
+}
+
+void traceSpan(const char* name, uint64_t start_ns, uint64_t end_ns, const char* arg_name, uint64_t arg) {
+    TraceRecord record = {};
+    record.phase = 'X';
+    record.name = name;
+    record.arg_name = arg_name;
+    record.arg = arg;
+    record.start_ns = start_ns;
+    record.end_ns = end_ns;
+    record.event = current_event;
+    push(record);
+}
+
+void traceFlush(const char* name, uint64_t start_ns, uint64_t end_ns, const TraceEventRange& events) {
+    TraceRecord record = {};
+    record.phase = 'X';
+    record.name = name;
+    record.start_ns = start_ns;
+    record.end_ns = end_ns;
+    record.event = events.last;
+    record.first_event = events.first;
+    record.first_event_ns = events.first_ns;
+    push(record);
+}
+
+void traceSetThreadName(const char* name) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+bool saveTrace(const std::string& filename) {
+    FILE* out = std::fopen(filename.c_str(), "w");
+    if (!out) {
+        std::cerr << "Failed to write trace file: " << filename << std::endl;
+        return false;
+    }
+
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        buffers = registry;
+    }
+
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", out);
+    bool first = true;
+    std::vector<TraceRecord> records;
+    records.reserve(BUFFER_RECORDS);
+    for (const auto& buffer : buffers) {
+        // в файл пишем уже без мьютекса, поток держим только на копирование
+        const char* name;
+        records.clear();
+        {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            name = buffer->name;
+            uint64_t end = buffer->written;
+            uint64_t begin = end > BUFFER_RECORDS ? end - BUFFER_RECORDS : 0;
+            for (uint64_t i = begin; i < end; i++) {
+                records.push_back(buffer->records[i % BUFFER_RECORDS]);
+            }
+        }
+
+        if (name) {
+            std::fprintf(out, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                         first ? "" : ",", buffer->tid);
+            writeJSONString(out, name);
+            std::fputs("}}", out);
+            first = false;
+        }
+        for (const TraceRecord& record : records) {
+            writeRecord(out, record, buffer->tid, first);
+        }
+    }
+    std::fputs("\n]}\n", out);
+
+    bool ok = std::ferror(out) == 0;
+    if (std::fclose(out) != 0) ok = false;
+    if (!ok) {
+        std::cerr << "Failed to write trace file: " << filename << std::endl;
+    }
+    return ok;
+}
@@ -0,0 +1,336 @@
+#include "undo_history.h"
+#include <algorithm>
+
+UndoHistory::UndoHistory(TFTDisplay& display, size_t budget_bytes, size_t checkpoint_interval)
+    : display(display), budget_bytes(budget_bytes),
+      checkpoint_interval(std::max<size_t>(checkpoint_interval, 1)),
+      tiles_x((display.getWidth() + TILE_SIZE - 1) / TILE_SIZE),
+      tiles_y((display.getHeight() + TILE_SIZE - 1) / TILE_SIZE),
+      first_action(0), position(0), stroke_open(false), memory_used(0) {
+    // базовая контрольная точка - весь кадр на момент создания
+    Checkpoint base;
+    base.action = 0;
+    captureTiles(base, std::vector<bool>(tiles_x * tiles_y, true));
+    memory_used += checkpointBytes(base);
+    checkpoints.push_back(std::move(base));
+}
+
+void UndoHistory::stampBrush(TFTDisplay& display, int16_t x, int16_t y, uint8_t size, uint16_t color) {
+    if (size <= 1) {
+        display.drawPixel(x, y, color);
+    } else {
+        display.fillCircle(x, y, size - 1, color);
+    }
+}
+
+void UndoHistory::beginStroke(uint16_t color, uint8_t brush_size) {
+    if (stroke_open) endStroke();
+    truncateRedo();
+
+    Action action;
+    action.type = ActionType::Stroke;
+    action.color = color;
+    action.brush_size = brush_size;
+    action.last_x = 0;
+    action.last_y = 0;
+    action.point_count = 0;
+    action.tiles.assign(tiles_x * tiles_y, false);
+    pushAction(std::move(action));
+    stroke_open = true;
+}
+
+bool UndoHistory::addPoint(int16_t x, int16_t y) {
+    if (!stroke_open) return true;
+
+    Action& action = actions.back();
+    if (action.point_count > 0 && x == action.last_x && y == action.last_y) {
+        return false;
+    }
+
+    size_t before = action.deltas.size();
+    int dx = x - action.last_x;
+    int dy = y - action.last_y;
+    if (action.point_count > 0 && dx >= -127 && dx <= 127 && dy >= -127 && dy <= 127) {
+        action.deltas.push_back(static_cast<int8_t>(dx));
+        action.deltas.push_back(static_cast<int8_t>(dy));
+    } else {
+        // первая точка или большой скачок - абсолютные координаты
+        action.deltas.push_back(DELTA_ESCAPE);
+        action.deltas.push_back(static_cast<int8_t>(x & 0xFF));
+        action.deltas.push_back(static_cast<int8_t>((x >> 8) & 0xFF));
+        action.deltas.push_back(static_cast<int8_t>(y & 0xFF));
+        action.deltas.push_back(static_cast<int8_t>((y >> 8) & 0xFF));
+    }
+    memory_used += action.deltas.size() - before;
+
+    action.last_x = x;
+    action.last_y = y;
+    action.point_count++;
+    markTiles(action, x, y);
+    return true;
+}
+
+void UndoHistory::endStroke() {
+    if (!stroke_open) return;
+    stroke_open = false;
+
+    // пустой мазок в историю не попадает
+    if (actions.back().point_count == 0) {
+        memory_used -= actionBytes(actions.back());
+        actions.pop_back();
+        position--;
+        return;
+    }
+
+    if (position - checkpoints.back().action >= checkpoint_interval) {
+        takeCheckpoint();
+    }
+    enforceBudget();
+}
+
+void UndoHistory::recordClear(uint16_t color) {
+    if (stroke_open) endStroke();
+    truncateRedo();
+
+    Action action;
+    action.type = ActionType::Clear;
+    action.color = color;
+    action.brush_size = 0;
+    action.last_x = 0;
+    action.last_y = 0;
+    action.point_count = 0;
+    action.tiles.assign(tiles_x * tiles_y, true);
+    pushAction(std::move(action));
+
+    if (position - checkpoints.back().action >= checkpoint_interval) {
+        takeCheckpoint();
+    }
+    enforceBudget();
+}
+
+void UndoHistory::recordSnapshot(int16_t y, int16_t height) {
+    y = std::max<int16_t>(y, 0);
+    height = std::min<int16_t>(height, display.getHeight() - y);
+    if (height <= 0) return;
+    if (stroke_open) endStroke();
+    truncateRedo();
+
+    Action action;
+    action.type = ActionType::Snapshot;
+    action.color = 0;
+    action.brush_size = 0;
+    action.last_x = 0;
+    action.last_y = y;
+    action.point_count = 0;
+    const uint16_t* pixels = display.getPixels();
+    int width = display.getWidth();
+    action.pixels.assign(&pixels[y * width], &pixels[(y + height) * width]);
+    action.tiles.assign(tiles_x * tiles_y, false);
+    for (int ty = y / TILE_SIZE; ty <= (y + height - 1) / TILE_SIZE; ty++) {
+        std::fill_n(action.tiles.begin() + ty * tiles_x, tiles_x, true);
+    }
+    pushAction(std::move(action));
+
+    if (position - checkpoints.back().action >= checkpoint_interval) {
+        takeCheckpoint();
+    }
+    enforceBudget();
+}
+
+bool UndoHistory::undo() {
+    if (stroke_open) endStroke();
+    if (!canUndo()) return false;
+
+    size_t target = position - 1;
+
+    // ближайшая контрольная точка не позже целевого состояния
+    size_t k = checkpoints.size() - 1;
+    while (checkpoints[k].action > target) {
+        k--;
+    }
+    size_t from = checkpoints[k].action;
+
+    // тайлы, изменённые после контрольной точки, возвращаем к ней
+    std::vector<bool> touched(tiles_x * tiles_y, false);
+    for (size_t i = from; i < position; i++) {
+        const Action& action = actionAt(i);
+        for (size_t t = 0; t < touched.size(); t++) {
+            if (action.tiles[t]) touched[t] = true;
+        }
+    }
+    for (size_t t = 0; t < touched.size(); t++) {
+        if (touched[t]) restoreTile(static_cast<int>(t), k);
+    }
+
+    // и проигрываем действия между контрольной точкой и целью
+    for (size_t i = from; i < target; i++) {
+        replay(actionAt(i));
+    }
+
+    position = target;
+    return true;
+}
+
+bool UndoHistory::redo() {
+    if (stroke_open || !canRedo()) return false;
+
+    replay(actionAt(position));
+    position++;
+    return true;
+}
+
+void UndoHistory::pushAction(Action&& action) {
+    memory_used += actionBytes(action);
+    actions.push_back(std::move(action));
+    position = first_action + actions.size();
+}
+
+void UndoHistory::truncateRedo() {
+    while (first_action + actions.size() > position) {
+        memory_used -= actionBytes(actions.back());
+        actions.pop_back();
+    }
+    while (checkpoints.size() > 1 && checkpoints.back().action > position) {
+        memory_used -= checkpointBytes(checkpoints.back());
+        checkpoints.pop_back();
+    }
+}
+
+void UndoHistory::markTiles(Action& action, int16_t x, int16_t y) const {
+    int radius = action.brush_size > 1 ? action.brush_size - 1 : 0;
+    int tx0 = std::max(0, (x - radius) / TILE_SIZE);
+    int ty0 = std::max(0, (y - radius) / TILE_SIZE);
+    int tx1 = std::min(tiles_x - 1, (x + radius) / TILE_SIZE);
+    int ty1 = std::min(tiles_y - 1, (y + radius) / TILE_SIZE);
+    if (x + radius < 0 || y + radius < 0) return;
+
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            action.tiles[ty * tiles_x + tx] = true;
+        }
+    }
+}
+
+void UndoHistory::replay(const Action& action) {
+    if (action.type == ActionType::Clear) {
+        display.clearScreen(action.color);
+        return;
+    }
+    if (action.type == ActionType::Snapshot) {
+        int width = display.getWidth();
+        display.blit(0, action.last_y, width, static_cast<int16_t>(action.pixels.size() / width),
+                     action.pixels.data(), width);
+        return;
+    }
+
+    int16_t x = 0;
+    int16_t y = 0;
+    const std::vector<int8_t>& d = action.deltas;
+    for (size_t i = 0; i < d.size();) {
+        if (d[i] == DELTA_ESCAPE) {
+            x = static_cast<int16_t>(static_cast<uint8_t>(d[i + 1]) | (static_cast<uint8_t>(d[i + 2]) << 8));
+            y = static_cast<int16_t>(static_cast<uint8_t>(d[i + 3]) | (static_cast<uint8_t>(d[i + 4]) << 8));
+            i += 5;
+        } else {
+            x += d[i];
+            y += d[i + 1];
+            i += 2;
+        }
+        stampBrush(display, x, y, action.brush_size, action.color);
+    }
+}
+
+void UndoHistory::takeCheckpoint() {
+    std::vector<bool> touched(tiles_x * tiles_y, false);
+    for (size_t i = checkpoints.back().action; i < position; i++) {
+        const Action& action = actionAt(i);
+        for (size_t t = 0; t < touched.size(); t++) {
+            if (action.tiles[t]) touched[t] = true;
+        }
+    }
+
+    Checkpoint checkpoint;
+    checkpoint.action = position;
+    captureTiles(checkpoint, touched);
+    memory_used += checkpointBytes(checkpoint);
+    checkpoints.push_back(std::move(checkpoint));
+}
+
+void UndoHistory::captureTiles(Checkpoint& checkpoint, const std::vector<bool>& tiles) const {
+    const uint16_t* pixels = display.getPixels();
+    int stride = display.getWidth();
+
+    for (int t = 0; t < tiles_x * tiles_y; t++) {
+        if (!tiles[t]) continue;
+
+        int x0 = (t % tiles_x) * TILE_SIZE;
+        int y0 = (t / tiles_x) * TILE_SIZE;
+        int w = std::min(TILE_SIZE, display.getWidth() - x0);
+        int h = std::min(TILE_SIZE, display.getHeight() - y0);
+
+        size_t offset = checkpoint.pixels.size();
+        checkpoint.tile_ids.push_back(t);
+        checkpoint.pixels.resize(offset + TILE_SIZE * TILE_SIZE, 0);
+        for (int row = 0; row < h; row++) {
+            std::copy_n(&pixels[(y0 + row) * stride + x0], w,
+                        &checkpoint.pixels[offset + row * TILE_SIZE]);
+        }
+    }
+}
+
+void UndoHistory::restoreTile(int tile, size_t checkpoint_index) {
+    // последняя версия тайла - в ближайшей контрольной точке, где он менялся;
+    // базовая точка содержит все тайлы
+    for (size_t k = checkpoint_index + 1; k-- > 0;) {
+        const Checkpoint& checkpoint = checkpoints[k];
+        auto it = std::lower_bound(checkpoint.tile_ids.begin(), checkpoint.tile_ids.end(), tile);
+        if (it == checkpoint.tile_ids.end() || *it != tile) continue;
+
+        size_t offset = (it - checkpoint.tile_ids.begin()) * TILE_SIZE * TILE_SIZE;
+        int x0 = (tile % tiles_x) * TILE_SIZE;
+        int y0 = (tile / tiles_x) * TILE_SIZE;
+        int w = std::min(TILE_SIZE, display.getWidth() - x0);
+        int h = std::min(TILE_SIZE, display.getHeight() - y0);
+        display.blit(x0, y0, w, h, &checkpoint.pixels[offset], TILE_SIZE);
+        return;
+    }
+}
+
+void UndoHistory::enforceBudget() {
+    while (memory_used > budget_bytes) {
+        // нечего сворачивать - фиксируем текущее состояние контрольной точкой
+        if (checkpoints.size() < 2 || checkpoints[1].action > position) {
+            if (position == checkpoints.back().action || checkpoints.back().action > position) {
+                break;
+            }
+            takeCheckpoint();
+        }
+
+        // старейшая контрольная точка вливается в базовую, история до неё теряется
+        Checkpoint& base = checkpoints[0];
+        Checkpoint& next = checkpoints[1];
+        for (size_t i = 0; i < next.tile_ids.size(); i++) {
+            std::copy_n(&next.pixels[i * TILE_SIZE * TILE_SIZE], TILE_SIZE * TILE_SIZE,
+                        &base.pixels[next.tile_ids[i] * TILE_SIZE * TILE_SIZE]);
+        }
+        base.action = next.action;
+        memory_used -= checkpointBytes(next);
+        checkpoints.erase(checkpoints.begin() + 1);
+
+        while (first_action < base.action) {
+            memory_used -= actionBytes(actions.front());
+            actions.pop_front();
+            first_action++;
+        }
+    }
+}
+
+size_t UndoHistory::actionBytes(const Action& action) const {
+    return sizeof(Action) + action.deltas.size() + action.pixels.size() * sizeof(uint16_t) +
+           (action.tiles.size() + 7) / 8;
+}
+
+size_t UndoHistory::checkpointBytes(const Checkpoint& checkpoint) const {
+    return sizeof(Checkpoint) + checkpoint.tile_ids.size() * sizeof(int) +
+           checkpoint.pixels.size() * sizeof(uint16_t);
+}
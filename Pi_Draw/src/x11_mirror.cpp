@@ -0,0 +1,283 @@
+#include "x11_mirror.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+namespace {
+
+// XShmAttach на удалённом сервере завершается асинхронной ошибкой,
+// перехватываем её на время подключения сегмента
+bool shm_attach_failed = false;
+
+int shmErrorHandler(Display*, XErrorEvent*) {
+    shm_attach_failed = true;
+    return 0;
+}
+
+// сдвиг и ширина маски компоненты визуала
+void maskShape(unsigned long mask, int& shift, int& bits) {
+    shift = 0;
+    bits = 0;
+    if (mask == 0) return;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        shift++;
+    }
+    while (mask & 1) {
+        mask >>= 1;
+        bits++;
+    }
+}
+
+// компонента из source_bits бит -> позиция маски визуала
+uint32_t scaleComponent(uint32_t value, int source_bits, unsigned long mask) {
+    int shift, bits;
+    maskShape(mask, shift, bits);
+    if (bits == 0) return 0;
+    // расширяем до 8 бит повтором старших разрядов, затем обрезаем до ширины маски
+    uint32_t v8 = (value << (8 - source_bits)) | (value >> (2 * source_bits - 8));
+    uint32_t v = bits >= 8 ? v8 << (bits - 8) : v8 >> (8 - bits);
+    return v << shift;
+}
+
+} // namespace
+
+X11Mirror::X11Mirror(int width, int height, int zoom)
+    : width(width), height(height), zoom(std::max(1, zoom)),
+      x_display(nullptr), window(0), gc(nullptr), x_image(nullptr),
+      use_shm(false), needs_full_update(true) {
+    std::memset(&shm_info, 0, sizeof(shm_info));
+    shm_info.shmid = -1;
+}
+
+X11Mirror::~X11Mirror() {
+    release();
+}
+
+bool X11Mirror::open(const char* title) {
+    x_display = XOpenDisplay(nullptr);
+    if (!x_display) {
+        std::cerr << "Не удалось подключиться к серверу\n";
+        return false;
+    }
+
+    int screen = DefaultScreen(x_display);
+    Visual* visual = DefaultVisual(x_display, screen);
+    int depth = DefaultDepth(x_display, screen);
+    if (visual->c_class != TrueColor) {
+        std::cerr << "Зеркало поддерживает только TrueColor визуал\n";
+        release();
+        return false;
+    }
+
+    window = XCreateSimpleWindow(x_display, RootWindow(x_display, screen),
+                                 0, 0, width * zoom, height * zoom, 1,
+                                 BlackPixel(x_display, screen),
+                                 BlackPixel(x_display, screen));
+    XStoreName(x_display, window, title);
+    // перерисовка только по Expose, фон окна сервер не заливает
+    XSetWindowBackgroundPixmap(x_display, window, None);
+    XSelectInput(x_display, window, ExposureMask);
+    XMapWindow(x_display, window);
+    gc = XCreateGC(x_display, window, 0, nullptr);
+
+    use_shm = createShmImage(visual, depth);
+    if (!use_shm && !createImage(visual, depth)) {
+        std::cerr << "Не удалось создать изображение зеркала\n";
+        release();
+        return false;
+    }
+
+    buildColorTables(visual);
+    needs_full_update = true;
+    return true;
+}
+
+bool X11Mirror::createShmImage(Visual* visual, int depth) {
+    if (!XShmQueryExtension(x_display)) return false;
+
+    x_image = XShmCreateImage(x_display, visual, depth, ZPixmap, nullptr, &shm_info,
+                              width * zoom, height * zoom);
+    if (!x_image) return false;
+
+    shm_info.shmid = shmget(IPC_PRIVATE, x_image->bytes_per_line * x_image->height,
+                            IPC_CREAT | 0600);
+    if (shm_info.shmid < 0) {
+        XDestroyImage(x_image);
+        x_image = nullptr;
+        return false;
+    }
+
+    shm_info.shmaddr = x_image->data = static_cast<char*>(shmat(shm_info.shmid, nullptr, 0));
+    shm_info.readOnly = False;
+
+    bool attached = false;
+    if (shm_info.shmaddr != reinterpret_cast<char*>(-1)) {
+        shm_attach_failed = false;
+        XErrorHandler previous = XSetErrorHandler(shmErrorHandler);
+        attached = XShmAttach(x_display, &shm_info);
+        XSync(x_display, False);
+        XSetErrorHandler(previous);
+        attached = attached && !shm_attach_failed;
+    }
+
+    // сегмент удалится сам, когда от него отключатся и мы, и сервер
+    shmctl(shm_info.shmid, IPC_RMID, nullptr);
+    if (attached) return true;
+
+    if (shm_info.shmaddr != reinterpret_cast<char*>(-1)) {
+        shmdt(shm_info.shmaddr);
+    }
+    x_image->data = nullptr;
+    XDestroyImage(x_image);
+    x_image = nullptr;
+    std::memset(&shm_info, 0, sizeof(shm_info));
+    shm_info.shmid = -1;
+    return false;
+}
+
+bool X11Mirror::createImage(Visual* visual, int depth) {
+    x_image = XCreateImage(x_display, visual, depth, ZPixmap, 0, nullptr,
+                           width * zoom, height * zoom, 32, 0);
+    if (!x_image) return false;
+
+    // память освобождает XDestroyImage
+    x_image->data = static_cast<char*>(std::calloc(x_image->bytes_per_line, x_image->height));
+    if (!x_image->data) {
+        XDestroyImage(x_image);
+        x_image = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void X11Mirror::buildColorTables(const Visual* visual) {
+    for (uint32_t i = 0; i < 32; i++) {
+        red_lut[i] = scaleComponent(i, 5, visual->red_mask);
+        blue_lut[i] = scaleComponent(i, 5, visual->blue_mask);
+    }
+    for (uint32_t i = 0; i < 64; i++) {
+        green_lut[i] = scaleComponent(i, 6, visual->green_mask);
+    }
+}
+
+void X11Mirror::convertRect(const uint16_t* pixels, int stride, const Rectangle& rect) {
+    const int bpp = x_image->bits_per_pixel;
+    const int line = x_image->bytes_per_line;
+
+    for (int y = rect.y; y < rect.y + rect.height; y++) {
+        const uint16_t* src = pixels + y * stride;
+        char* dst_row = x_image->data + y * zoom * line;
+
+        for (int x = rect.x; x < rect.x + rect.width; x++) {
+            uint16_t c = src[x];
+            uint32_t value = red_lut[c >> 11] | green_lut[(c >> 5) & 0x3F] | blue_lut[c & 0x1F];
+            int dx = x * zoom;
+            if (bpp == 32) {
+                uint32_t* dst = reinterpret_cast<uint32_t*>(dst_row) + dx;
+                for (int i = 0; i < zoom; i++) dst[i] = value;
+            } else if (bpp == 16) {
+                uint16_t* dst = reinterpret_cast<uint16_t*>(dst_row) + dx;
+                for (int i = 0; i < zoom; i++) dst[i] = static_cast<uint16_t>(value);
+            } else {
+                for (int i = 0; i < zoom; i++) XPutPixel(x_image, dx + i, y * zoom, value);
+            }
+        }
+
+        // остальные строки увеличенного пикселя - копии первой
+        size_t offset = static_cast<size_t>(rect.x) * zoom * bpp / 8;
+        size_t bytes = static_cast<size_t>(rect.width) * zoom * bpp / 8;
+        for (int i = 1; i < zoom; i++) {
+            std::memcpy(dst_row + i * line + offset, dst_row + offset, bytes);
+        }
+    }
+}
+
+void X11Mirror::putRect(const Rectangle& rect) {
+    int x = rect.x * zoom;
+    int y = rect.y * zoom;
+    unsigned int w = rect.width * zoom;
+    unsigned int h = rect.height * zoom;
+    if (use_shm) {
+        XShmPutImage(x_display, window, gc, x_image, x, y, x, y, w, h, False);
+    } else {
+        XPutImage(x_display, window, gc, x_image, x, y, x, y, w, h);
+    }
+}
+
+void X11Mirror::processEvents() {
+    while (XPending(x_display)) {
+        XEvent event;
+        XNextEvent(x_display, &event);
+        if (event.type == Expose) {
+            needs_full_update = true;
+        }
+    }
+}
+
+void X11Mirror::update(const uint16_t* pixels, int stride, const std::vector<Rectangle>& rects) {
+    if (!x_display) return;
+
+    processEvents();
+    if (rects.empty() && !needs_full_update) return;
+
+    bool pushed = false;
+    auto push = [&](const Rectangle& r) {
+        int x0 = std::max<int>(r.x, 0);
+        int y0 = std::max<int>(r.y, 0);
+        int x1 = std::min<int>(r.x + r.width, width);
+        int y1 = std::min<int>(r.y + r.height, height);
+        if (x0 >= x1 || y0 >= y1) return;
+        Rectangle clipped(x0, y0, x1 - x0, y1 - y0);
+        convertRect(pixels, stride, clipped);
+        putRect(clipped);
+        pushed = true;
+    };
+
+    if (needs_full_update) {
+        push(Rectangle(0, 0, width, height));
+        needs_full_update = false;
+    } else {
+        for (const Rectangle& rect : rects) {
+            push(rect);
+        }
+    }
+
+    if (!pushed) return;
+    // сервер читает разделяемую память асинхронно: ждём, чтобы следующий
+    // вызов не перезаписал изображение во время вывода
+    if (use_shm) {
+        XSync(x_display, False);
+    } else {
+        XFlush(x_display);
+    }
+}
+
+void X11Mirror::release() {
+    if (!x_display) return;
+
+    if (x_image) {
+        if (use_shm) {
+            XShmDetach(x_display, &shm_info);
+            XSync(x_display, False);
+            shmdt(shm_info.shmaddr);
+            x_image->data = nullptr;
+        }
+        XDestroyImage(x_image);
+        x_image = nullptr;
+    }
+    if (gc) {
+        XFreeGC(x_display, gc);
+        gc = nullptr;
+    }
+    if (window) {
+        XDestroyWindow(x_display, window);
+        window = 0;
+    }
+    XCloseDisplay(x_display);
+    x_display = nullptr;
+    use_shm = false;
+}